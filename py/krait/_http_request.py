@@ -1,5 +1,6 @@
 ﻿import collections
 import urllib
+import cStringIO
 
 
 class Request(object):
@@ -14,7 +15,8 @@ class Request(object):
         query_string (str): The URL query
         http_version (str): the HTTP version; only 'HTTP/1.1' is supported
         headers (dict of str str): The HTTP headers sent by the client
-        body (str): The body of the request
+        body (str): The body of the request, or None if it's in ``body_file``
+        body_file (file, optional): The body of the request, for bodies too large to keep in memory
 
     Attributes:
         http_method (str): The HTTP method in the request. Values: 'GET', 'POST', etc.
@@ -27,13 +29,35 @@ class Request(object):
     A named tuple to hold a multipart form entry.
     """
 
-    def __init__(self, http_method, url, query_string, http_version, headers, body):
+    def __init__(self, http_method, url, query_string, http_version, headers, body, body_file=None):
         self.http_method = http_method
         self.url = url
         self.query = Request._get_query(query_string)
         self.http_version = http_version
         self.headers = headers
-        self.body = body
+        self._body = body
+        self._body_file = body_file
+
+    @property
+    def body(self):
+        """
+        str: The body of the request.
+        Bodies larger than :obj:`krait.config.body_spill_threshold` are read from their file on first use;
+        prefer :obj:`Request.body_file` for those.
+        """
+        if self._body is None:
+            self._body_file.seek(0)
+            self._body = self._body_file.read()
+        return self._body
+
+    @property
+    def body_file(self):
+        """
+        file: A file-like object to read the body of the request from, without loading all of it in memory.
+        """
+        if self._body_file is None:
+            self._body_file = cStringIO.StringIO(self._body)
+        return self._body_file
 
     def get_post_form(self):
         """
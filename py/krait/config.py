@@ -94,3 +94,91 @@ int:
 The number of seconds that clients should not re-request the resource, for long-term cached resources.
 This corresponds to the Max-Age of the HTTP responses, for long-term, public or private, cached resources.
 """
+
+
+body_spill_threshold = 1048576
+"""
+int:
+The request body size (in bytes) above which Krait writes the body to a temporary file as it arrives,
+instead of keeping it in memory. Such bodies are best read through :obj:`krait.Request.body_file`.
+None keeps all bodies in memory.
+"""
+
+
+max_body_size = None
+"""
+int:
+The largest request body (in bytes) that Krait accepts. Larger requests are answered with 413 Request Entity Too Large
+before their body is read; clients that sent ``Expect: 100-continue`` never send it at all.
+Chunked bodies are turned down with 413 as soon as their chunks add up to more.
+None means no limit.
+"""
+
+
+stream_buffer_size = None
+"""
+int:
+If set, the amount of output (in bytes) Krait renders before it starts sending a dynamic page.
+Longer pages are sent to HTTP/1.1 clients with chunked transfer encoding as they render,
+each chunk holding about this many bytes (65536 is a reasonable value). Headers, cookies and :obj:`krait.response`
+must be set before that much output has been rendered; later changes can't be sent, and are logged as errors.
+None (the default) renders every page fully before sending it.
+"""
+
+
+send_timeout = 60
+"""
+float:
+How long (in seconds) Krait waits for a client that takes no response data before dropping the connection.
+This keeps slow or stalled clients from holding a worker indefinitely.
+None waits forever.
+"""
+
+
+open_file_cache_size = 256
+"""
+int:
+How many static files each worker keeps open, with their size, modification time and ETag,
+so requests for them skip the filesystem. Each one holds a file descriptor, plus one for each precompressed copy
+it has (``.gz``, ``.br``): up to three per entry, which counts against the open file limit. 0 disables the cache.
+With ``--workers 0`` each connection gets a process of its own, so the cache only lasts as long as the connection.
+With ``--static-threads``, the static file process splits this many entries between its threads.
+"""
+
+
+open_file_cache_valid = 5
+"""
+int:
+How long (in seconds) an open static file is served before Krait checks it again on disk.
+Changes to a static file may take this long to show.
+"""
+
+
+precompress_static = False
+"""
+bool:
+Whether Krait writes compressed copies of compressible static files (``app.js.gz``, and ``app.js.br``
+if built with Brotli) in the background after it starts, for files that lack them or whose copies are older than them.
+Precompressed copies, whether made by Krait or by a build step, are sent to clients that accept
+their encoding, with ``Content-Encoding`` and ``Vary: Accept-Encoding``.
+"""
+
+
+compress_level = None
+"""
+int:
+If set, the compression level (1-9) for dynamic responses (Pyml pages, Python pages and :obj:`krait.response` bodies)
+with compressible content types, sent with ``Content-Encoding: gzip`` to clients that accept it.
+If Krait is built with Brotli, clients that prefer ``br`` get Brotli at the same quality.
+Streamed pages are compressed as they render. Compression costs CPU for every response, so it's off by default;
+6 is a good balance. None (the default) sends dynamic responses uncompressed; any other value outside 1-9 stops
+Krait at startup.
+"""
+
+
+compress_min_size = 1024
+"""
+int:
+Dynamic responses shorter than this many bytes are sent uncompressed, since compression gains little on them.
+Streamed pages are always compressed.
+"""
@@ -40,9 +40,12 @@ CacheController::CachePragma CacheController::getCacheControl(std::string target
 
 	std::pair<std::string, bool> cacheKey = make_pair(targetFilename, defaultIsStore);
 
-	const auto it = pragmaCache.find(cacheKey);
-	if (it != pragmaCache.end()) {
-		return it->second;
+	{
+		std::lock_guard<std::mutex> lock(pragmaCacheMutex);
+		const auto it = pragmaCache.find(cacheKey);
+		if (it != pragmaCache.end()) {
+			return it->second;
+		}
 	}
 
 	CachePragma result;
@@ -73,6 +76,7 @@ CacheController::CachePragma CacheController::getCacheControl(std::string target
 		result.isStore = true;
 	}
 
+	std::lock_guard<std::mutex> lock(pragmaCacheMutex);
 	pragmaCache[cacheKey] = result;
 
 	return result;
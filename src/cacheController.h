@@ -3,6 +3,7 @@
 #include<string>
 #include<map>
 #include<utility>
+#include<mutex>
 #include"regexList.h"
 #include "config.h"
 
@@ -28,7 +29,9 @@ private:
 	int maxAgeDefault;
 	int maxAgeLongTerm;
 
+	//Static files are looked up from several threads at once.
 	std::map<std::pair<std::string, bool>, CachePragma> pragmaCache;
+	std::mutex pragmaCacheMutex;
 
 	bool loaded;
 
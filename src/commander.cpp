@@ -142,6 +142,10 @@ bool processCommand(pid_t mainPid, const char* cmd, int cmdLen) {
 		kill(mainPid, SIGTERM);
 		return processCommand(mainPid, cmd + 2, cmdLen - 2);
 	}
+	if (cmdLen >= 2 && cmd[0] == '^' && cmd[1] == 'R') {
+		kill(mainPid, SIGHUP);
+		return processCommand(mainPid, cmd + 2, cmdLen - 2);
+	}
 	return false;
 }
 
@@ -168,3 +172,7 @@ void sendCommandClose() {
 void sendCommandKill() {
 	sendCommand("^K");
 }
+
+void sendCommandReload() {
+	sendCommand("^R");
+}
@@ -4,4 +4,5 @@
 void startCommanderProcess();
 void sendCommandClose();
 void sendCommandKill();
+void sendCommandReload();
 std::string getCreateDotKrait();
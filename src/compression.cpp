@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <boost/algorithm/string/predicate.hpp>
+#include "compression.h"
+#include "utils.h"
+#include "except.h"
+
+#define DBG_DISABLE
+#include "dbg.h"
+
+namespace ba = boost::algorithm;
+
+
+//Text compresses well; images, archives and media are compressed already.
+bool isCompressibleType(const std::string& contentType) {
+	return ba::istarts_with(contentType, "text/") ||
+		ba::istarts_with(contentType, "application/javascript") ||
+		ba::istarts_with(contentType, "application/json") ||
+		ba::istarts_with(contentType, "application/xml") ||
+		ba::istarts_with(contentType, "application/xhtml+xml") ||
+		ba::istarts_with(contentType, "image/svg+xml");
+}
+
+
+//Written next to the destination, then renamed over it, so a half-written variant is never served.
+bool gzipFile(const std::string& sourcePath, const std::string& destPath) {
+	std::string tempPath = destPath + ".tmp";
+	FILE* source = fopen(sourcePath.c_str(), "rb");
+	if (source == NULL) {
+		return false;
+	}
+	gzFile dest = gzopen(tempPath.c_str(), "wb9");
+	if (dest == NULL) {
+		fclose(source);
+		return false;
+	}
+
+	char buffer[65536];
+	size_t bytesRead;
+	bool success = true;
+	while (success && (bytesRead = fread(buffer, 1, sizeof(buffer), source)) != 0) {
+		success = gzwrite(dest, buffer, (unsigned)bytesRead) == (int)bytesRead;
+	}
+	success = !ferror(source) && success;
+	fclose(source);
+	success = gzclose(dest) == Z_OK && success;
+
+	if (!success || rename(tempPath.c_str(), destPath.c_str()) != 0) {
+		unlink(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+#ifdef KRAIT_HAVE_BROTLI
+bool brotliFile(const std::string& sourcePath, const std::string& destPath, int quality) {
+	std::string source;
+	try {
+		source = readFromFile(sourcePath);
+	}
+	catch (rootException&) {
+		return false;
+	}
+
+	size_t compressedLength = BrotliEncoderMaxCompressedSize(source.length());
+	if (compressedLength == 0) {
+		return false;
+	}
+	std::string compressed(compressedLength, '\0');
+	if (!BrotliEncoderCompress(quality, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, source.length(),
+		(const uint8_t*)source.data(), &compressedLength, (uint8_t*)&compressed[0])) {
+		return false;
+	}
+
+	std::string tempPath = destPath + ".tmp";
+	FILE* dest = fopen(tempPath.c_str(), "wb");
+	if (dest == NULL) {
+		return false;
+	}
+	bool success = fwrite(compressed.data(), 1, compressedLength, dest) == compressedLength;
+	success = fclose(dest) == 0 && success;
+
+	if (!success || rename(tempPath.c_str(), destPath.c_str()) != 0) {
+		unlink(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+#endif
+
+
+GzipStream::GzipStream(int level) {
+	stream.zalloc = Z_NULL;
+	stream.zfree = Z_NULL;
+	stream.opaque = Z_NULL;
+	//15 window bits, +16 for a gzip header and trailer instead of a zlib one.
+	if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		BOOST_THROW_EXCEPTION(serverError() << stringInfo("deflateInit2: could not start gzip stream."));
+	}
+}
+
+GzipStream::~GzipStream() {
+	deflateEnd(&stream);
+}
+
+const std::string& GzipStream::deflateAll(const std::string& data, int flushMode) {
+	output.clear();
+	stream.next_in = (Bytef*)data.data();
+	stream.avail_in = (uInt)data.length();
+
+	char buffer[16384];
+	int status;
+	do {
+		stream.next_out = (Bytef*)buffer;
+		stream.avail_out = sizeof(buffer);
+		status = deflate(&stream, flushMode);
+		if (status == Z_STREAM_ERROR) {
+			BOOST_THROW_EXCEPTION(serverError() << stringInfo("deflate: gzip stream error."));
+		}
+		output.append(buffer, sizeof(buffer) - stream.avail_out);
+	}
+	while (stream.avail_out == 0 || stream.avail_in != 0);
+
+	return output;
+}
+
+const std::string& GzipStream::compress(const std::string& data, bool flush) {
+	return deflateAll(data, flush ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+}
+
+const std::string& GzipStream::finish() {
+	return deflateAll(std::string(), Z_FINISH);
+}
+
+
+#ifdef KRAIT_HAVE_BROTLI
+BrotliStream::BrotliStream(int quality) {
+	state = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+	if (state == NULL) {
+		BOOST_THROW_EXCEPTION(serverError() << stringInfo("BrotliEncoderCreateInstance: could not start brotli stream."));
+	}
+	BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY, (uint32_t)quality);
+	BrotliEncoderSetParameter(state, BROTLI_PARAM_MODE, BROTLI_MODE_TEXT);
+}
+
+BrotliStream::~BrotliStream() {
+	BrotliEncoderDestroyInstance(state);
+}
+
+const std::string& BrotliStream::compressAll(const std::string& data, BrotliEncoderOperation operation) {
+	output.clear();
+	size_t availableIn = data.length();
+	const uint8_t* nextIn = (const uint8_t*)data.data();
+
+	uint8_t buffer[16384];
+	do {
+		size_t availableOut = sizeof(buffer);
+		uint8_t* nextOut = buffer;
+		if (!BrotliEncoderCompressStream(state, operation, &availableIn, &nextIn, &availableOut, &nextOut, NULL)) {
+			BOOST_THROW_EXCEPTION(serverError() << stringInfo("BrotliEncoderCompressStream: brotli stream error."));
+		}
+		output.append((const char*)buffer, sizeof(buffer) - availableOut);
+	}
+	while (availableIn != 0 || BrotliEncoderHasMoreOutput(state) ||
+		(operation == BROTLI_OPERATION_FINISH && !BrotliEncoderIsFinished(state)));
+
+	return output;
+}
+
+const std::string& BrotliStream::compress(const std::string& data, bool flush) {
+	return compressAll(data, flush ? BROTLI_OPERATION_FLUSH : BROTLI_OPERATION_PROCESS);
+}
+
+const std::string& BrotliStream::finish() {
+	return compressAll(std::string(), BROTLI_OPERATION_FINISH);
+}
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+#include <string>
+#include <zlib.h>
+#ifdef KRAIT_HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+
+bool isCompressibleType(const std::string& contentType);
+
+bool gzipFile(const std::string& sourcePath, const std::string& destPath);
+#ifdef KRAIT_HAVE_BROTLI
+bool brotliFile(const std::string& sourcePath, const std::string& destPath, int quality);
+#endif
+
+
+//Compresses a body as it is sent. The returned output is only valid until the next call.
+class ICompressionStream
+{
+public:
+	virtual ~ICompressionStream() {
+	}
+
+	//With flush, everything given so far can be decoded from the output (at some cost in ratio).
+	virtual const std::string& compress(const std::string& data, bool flush) = 0;
+	virtual const std::string& finish() = 0;
+};
+
+
+class GzipStream : public ICompressionStream
+{
+	z_stream stream;
+	std::string output;
+
+	const std::string& deflateAll(const std::string& data, int flushMode);
+
+public:
+	GzipStream(int level);
+	GzipStream(const GzipStream&) = delete;
+	GzipStream& operator=(const GzipStream&) = delete;
+	~GzipStream();
+
+	const std::string& compress(const std::string& data, bool flush) override;
+	const std::string& finish() override;
+};
+
+#ifdef KRAIT_HAVE_BROTLI
+class BrotliStream : public ICompressionStream
+{
+	BrotliEncoderState* state;
+	std::string output;
+
+	const std::string& compressAll(const std::string& data, BrotliEncoderOperation operation);
+
+public:
+	BrotliStream(int quality);
+	BrotliStream(const BrotliStream&) = delete;
+	BrotliStream& operator=(const BrotliStream&) = delete;
+	~BrotliStream();
+
+	const std::string& compress(const std::string& data, bool flush) override;
+	const std::string& finish() override;
+};
+#endif
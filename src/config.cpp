@@ -33,13 +33,81 @@ void Config::loadRoutes() {
 	}
 }
 
+void Config::loadLimits() {
+	try {
+		bp::object pySpillThreshold = PythonModule::config.getGlobalVariable("body_spill_threshold");
+		if (pySpillThreshold.is_none()) {
+			bodySpillThreshold = 0;
+		}
+		else {
+			bodySpillThreshold = bp::extract<size_t>(pySpillThreshold);
+		}
+
+		bp::object pyMaxBodySize = PythonModule::config.getGlobalVariable("max_body_size");
+		if (pyMaxBodySize.is_none()) {
+			maxBodySize = 0;
+		}
+		else {
+			maxBodySize = bp::extract<unsigned long long>(pyMaxBodySize);
+		}
+
+		bp::object pyStreamBufferSize = PythonModule::config.getGlobalVariable("stream_buffer_size");
+		if (pyStreamBufferSize.is_none()) {
+			streamBufferSize = 0;
+		}
+		else {
+			streamBufferSize = bp::extract<size_t>(pyStreamBufferSize);
+		}
+
+		bp::object pySendTimeout = PythonModule::config.getGlobalVariable("send_timeout");
+		if (pySendTimeout.is_none()) {
+			sendTimeoutMs = -1;
+		}
+		else {
+			sendTimeoutMs = (int)(bp::extract<double>(pySendTimeout) * 1000);
+		}
+
+		openFileCacheSize = bp::extract<size_t>(PythonModule::config.getGlobalVariable("open_file_cache_size"));
+		openFileCacheValidSec = bp::extract<int>(PythonModule::config.getGlobalVariable("open_file_cache_valid"));
+		precompressStatic = bp::extract<bool>(PythonModule::config.getGlobalVariable("precompress_static"));
+
+		bp::object pyCompressLevel = PythonModule::config.getGlobalVariable("compress_level");
+		if (pyCompressLevel.is_none()) {
+			compressLevel = -1;
+		}
+		else {
+			compressLevel = bp::extract<int>(pyCompressLevel);
+			if (compressLevel < 1 || compressLevel > 9) {
+				BOOST_THROW_EXCEPTION(serverError() << stringInfoFromFormat(
+					"Error: compress_level must be between 1 and 9, or None; it is %1%.", compressLevel));
+			}
+		}
+		compressMinSize = bp::extract<size_t>(PythonModule::config.getGlobalVariable("compress_min_size"));
+	}
+	catch (bp::error_already_set const&) {
+		DBG("Python error in loadLimits!");
+
+		BOOST_THROW_EXCEPTION(pythonError() << getPyErrorInfo() << originCallInfo("loadLimits"));
+	}
+}
+
 Config::Config() {
 	initialized = false;
 	routes.clear();
+	bodySpillThreshold = 0;
+	maxBodySize = 0;
+	streamBufferSize = 0;
+	sendTimeoutMs = -1;
+	openFileCacheSize = 0;
+	openFileCacheValidSec = 0;
+	precompressStatic = false;
+	compressLevel = -1;
+	compressMinSize = 0;
 }
 
 void Config::load() {
 	loadRoutes();
+	loadLimits();
 	initialized = true;
 }
 
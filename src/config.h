@@ -8,11 +8,63 @@ private:
 	bool initialized;
 
 	std::vector<Route> routes;
+	size_t bodySpillThreshold;
+	unsigned long long maxBodySize;
+	size_t streamBufferSize;
+	int sendTimeoutMs;
+	size_t openFileCacheSize;
+	int openFileCacheValidSec;
+	bool precompressStatic;
+	int compressLevel;
+	size_t compressMinSize;
+
 	void loadRoutes();
+	void loadLimits();
 
 public:
 	Config();
 	void load();
 
 	std::vector<Route>& getRoutes();
+
+	size_t getBodySpillThreshold() const {
+		return bodySpillThreshold;
+	}
+
+	//0 means no limit.
+	unsigned long long getMaxBodySize() const {
+		return maxBodySize;
+	}
+
+	//0 means pages are not streamed.
+	size_t getStreamBufferSize() const {
+		return streamBufferSize;
+	}
+
+	//-1 means no timeout.
+	int getSendTimeoutMs() const {
+		return sendTimeoutMs;
+	}
+
+	//0 means static files are not kept open.
+	size_t getOpenFileCacheSize() const {
+		return openFileCacheSize;
+	}
+
+	int getOpenFileCacheValidSec() const {
+		return openFileCacheValidSec;
+	}
+
+	bool getPrecompressStatic() const {
+		return precompressStatic;
+	}
+
+	//-1 means dynamic responses are not compressed.
+	int getCompressLevel() const {
+		return compressLevel;
+	}
+
+	size_t getCompressMinSize() const {
+		return compressMinSize;
+	}
 };
@@ -0,0 +1,94 @@
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include "eventLoop.h"
+#include "utils.h"
+#include "except.h"
+
+#define DBG_DISABLE
+#include "dbg.h"
+
+
+EventLoop::EventLoop() {
+	epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (epollFd == -1) {
+		BOOST_THROW_EXCEPTION(syscallError() << stringInfo("epoll_create1(): creating event loop") << errcodeInfoDef());
+	}
+}
+
+EventLoop::~EventLoop() {
+	close();
+}
+
+
+bool EventLoop::addFd(int fd, uint32_t events, eventHandler handler) {
+	epoll_event event;
+	memzero(event);
+	event.events = events;
+	event.data.fd = fd;
+
+	if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+		if (errno == EPERM) {
+			//The file doesn't support polling (e.g. a regular file).
+			return false;
+		}
+		BOOST_THROW_EXCEPTION(syscallError() << stringInfoFromFormat("epoll_ctl(): adding fd %1% to event loop", fd) << errcodeInfoDef());
+	}
+
+	handlers[fd] = handler;
+	return true;
+}
+
+void EventLoop::modifyFd(int fd, uint32_t events) {
+	epoll_event event;
+	memzero(event);
+	event.events = events;
+	event.data.fd = fd;
+
+	if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) != 0) {
+		BOOST_THROW_EXCEPTION(syscallError() << stringInfoFromFormat("epoll_ctl(): modifying fd %1% in event loop", fd) << errcodeInfoDef());
+	}
+}
+
+void EventLoop::removeFd(int fd) {
+	if (handlers.erase(fd) == 0) {
+		return;
+	}
+
+	if (epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL) != 0 && errno != EBADF && errno != ENOENT) {
+		BOOST_THROW_EXCEPTION(syscallError() << stringInfoFromFormat("epoll_ctl(): removing fd %1% from event loop", fd) << errcodeInfoDef());
+	}
+}
+
+
+void EventLoop::runOnce(int timeoutMs) {
+	const int maxEvents = 64;
+	epoll_event events[maxEvents];
+
+	int nrEvents = epoll_wait(epollFd, events, maxEvents, timeoutMs);
+	if (nrEvents == -1) {
+		if (errno == EINTR) {
+			return;
+		}
+		BOOST_THROW_EXCEPTION(syscallError() << stringInfo("epoll_wait(): running event loop") << errcodeInfoDef());
+	}
+
+	for (int i = 0; i < nrEvents; i++) {
+		//A previous handler may have removed this fd; look the handler up every time.
+		auto it = handlers.find(events[i].data.fd);
+		if (it == handlers.end()) {
+			continue;
+		}
+		eventHandler handler = it->second;
+		handler(events[i].events);
+	}
+}
+
+
+void EventLoop::close() {
+	if (epollFd != -1) {
+		::close(epollFd);
+		epollFd = -1;
+	}
+	handlers.clear();
+}
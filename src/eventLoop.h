@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <sys/epoll.h>
+
+/*
+	A minimal epoll reactor: file descriptors are registered with a handler, which gets called with
+	the ready events as soon as the descriptor is ready.
+*/
+class EventLoop
+{
+public:
+	typedef std::function<void(uint32_t)> eventHandler;
+
+private:
+	int epollFd;
+	std::unordered_map<int, eventHandler> handlers;
+
+public:
+	EventLoop();
+	~EventLoop();
+
+	bool addFd(int fd, uint32_t events, eventHandler handler);
+	void modifyFd(int fd, uint32_t events);
+	void removeFd(int fd);
+
+	bool hasFd(int fd) const {
+		return handlers.find(fd) != handlers.end();
+	}
+
+	void runOnce(int timeoutMs);
+
+	void close();
+};
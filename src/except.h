@@ -39,6 +39,10 @@ struct httpParseError: virtual rootException
 {
 };
 
+struct bodyTooLargeError: virtual httpParseError
+{
+};
+
 struct routeParseError: virtual rootException
 {
 };
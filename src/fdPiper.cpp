@@ -0,0 +1,109 @@
+#include<unistd.h>
+#include<errno.h>
+#include<string.h>
+#include<sys/socket.h>
+#include"fdPiper.h"
+#include"except.h"
+#include"utils.h"
+
+#define DBG_DISABLE
+#include"dbg.h"
+
+FdPiper::FdPiper() {
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, sockets) == -1) {
+		BOOST_THROW_EXCEPTION(syscallError() << stringInfo("socketpair(): creating socket pair for FdPiper") << errcodeInfoDef());
+	}
+	readHead = sockets[0];
+	writeHead = sockets[1];
+}
+
+FdPiper::~FdPiper() {
+	closePipes();
+}
+
+
+void FdPiper::closePipes() {
+	closeRead();
+	closeWrite();
+}
+
+void FdPiper::closeRead() {
+	if (readHead != -1) {
+		close(readHead);
+		readHead = -1;
+	}
+}
+
+void FdPiper::closeWrite() {
+	if (writeHead != -1) {
+		close(writeHead);
+		writeHead = -1;
+	}
+}
+
+//Returns false if the other side can't take more descriptors right now (or is gone).
+bool FdPiper::pipeWrite(int fd, int64_t info) {
+	DBG_FMT("FdPiper::pipeWrite(%1%, %2%) on fd %3%", fd, info, writeHead);
+	iovec dataVec;
+	dataVec.iov_base = &info;
+	dataVec.iov_len = sizeof(info);
+
+	char control[CMSG_SPACE(sizeof(int))];
+	memzero(control);
+
+	msghdr message;
+	memzero(message);
+	message.msg_iov = &dataVec;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+
+	cmsghdr* controlMessage = CMSG_FIRSTHDR(&message);
+	controlMessage->cmsg_level = SOL_SOCKET;
+	controlMessage->cmsg_type = SCM_RIGHTS;
+	controlMessage->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(controlMessage), &fd, sizeof(int));
+
+	if (sendmsg(writeHead, &message, MSG_DONTWAIT | MSG_NOSIGNAL) == -1) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS || errno == ECONNREFUSED) {
+			return false;
+		}
+		BOOST_THROW_EXCEPTION(syscallError() << stringInfo("sendmsg(): passing fd in FdPiper::pipeWrite") << errcodeInfoDef());
+	}
+	return true;
+}
+
+//Returns -1 if there is nothing to read (or another process was faster).
+int FdPiper::pipeRead(int64_t* info) {
+	iovec dataVec;
+	dataVec.iov_base = info;
+	dataVec.iov_len = sizeof(*info);
+
+	char control[CMSG_SPACE(sizeof(int))];
+	memzero(control);
+
+	msghdr message;
+	memzero(message);
+	message.msg_iov = &dataVec;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+
+	if (recvmsg(readHead, &message, MSG_DONTWAIT | MSG_CMSG_CLOEXEC) == -1) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+			return -1;
+		}
+		BOOST_THROW_EXCEPTION(syscallError() << stringInfo("recvmsg(): receiving fd in FdPiper::pipeRead") << errcodeInfoDef());
+	}
+
+	cmsghdr* controlMessage = CMSG_FIRSTHDR(&message);
+	if (controlMessage == NULL || controlMessage->cmsg_level != SOL_SOCKET || controlMessage->cmsg_type != SCM_RIGHTS) {
+		return -1;
+	}
+
+	int fd;
+	memcpy(&fd, CMSG_DATA(controlMessage), sizeof(int));
+	DBG_FMT("FdPiper::pipeRead(): got fd %1% on fd %2%", fd, readHead);
+	return fd;
+}
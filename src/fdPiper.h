@@ -0,0 +1,32 @@
+#pragma once
+#include<cstdint>
+
+/*
+	Like StringPiper, but passes file descriptors (with a number attached) between processes.
+	Built on a datagram socket pair, so any number of processes can read from the same end;
+	each descriptor is received by exactly one of them.
+*/
+class FdPiper
+{
+	int readHead;
+	int writeHead;
+
+public:
+	FdPiper();
+	~FdPiper();
+
+	int getReadHead() const {
+		return readHead;
+	}
+
+	int getWriteHead() const {
+		return writeHead;
+	}
+
+	void closeRead();
+	void closeWrite();
+	void closePipes();
+
+	bool pipeWrite(int fd, int64_t info);
+	int pipeRead(int64_t* info);
+};
@@ -1,5 +1,12 @@
 #include<string>
 #include <map>
+#include <climits>
+#include <cstring>
+#include <algorithm>
+#include <ctype.h>
+#include <cstdlib>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
 #include"http.h"
 
 
@@ -83,3 +90,119 @@ RouteVerb toRouteVerb(std::string str) {
 		return it->second;
 	}
 }
+
+
+static bool parseRangeNumber(const std::string& str, size_t from, size_t to, unsigned long long* result) {
+	if (from == to) {
+		return false;
+	}
+	unsigned long long value = 0;
+	for (size_t idx = from; idx < to; idx++) {
+		if (!isdigit(str[idx]) || value > ULLONG_MAX / 10 - 1) {
+			return false;
+		}
+		value = value * 10 + (str[idx] - '0');
+	}
+	*result = value;
+	return true;
+}
+
+//Reads a Range header ("bytes=0-99,200-,-50") for a resource of the given size, clamping ranges to it.
+//Returns false if the header should be ignored (another unit, or malformed); no ranges means none can be satisfied.
+bool parseByteRanges(const std::string& value, unsigned long long size, std::vector<ByteRange>& ranges) {
+	ranges.clear();
+	if (!boost::algorithm::istarts_with(value, "bytes=")) {
+		return false;
+	}
+
+	size_t pos = strlen("bytes=");
+	bool anySpec = false;
+	while (pos <= value.length()) {
+		size_t specEnd = value.find(',', pos);
+		if (specEnd == std::string::npos) {
+			specEnd = value.length();
+		}
+
+		size_t start = pos;
+		size_t end = specEnd;
+		while (start < end && (value[start] == ' ' || value[start] == '\t')) {
+			start++;
+		}
+		while (end > start && (value[end - 1] == ' ' || value[end - 1] == '\t')) {
+			end--;
+		}
+		pos = specEnd + 1;
+		if (start == end) {
+			continue;
+		}
+		anySpec = true;
+
+		size_t dash = value.find('-', start);
+		if (dash == std::string::npos || dash >= end) {
+			return false;
+		}
+
+		unsigned long long first;
+		unsigned long long last;
+		if (dash == start) {
+			//The last N bytes.
+			if (!parseRangeNumber(value, dash + 1, end, &last)) {
+				return false;
+			}
+			if (last != 0 && size != 0) {
+				first = last < size ? size - last : 0;
+				ranges.push_back(ByteRange{first, size - first});
+			}
+			continue;
+		}
+
+		if (!parseRangeNumber(value, start, dash, &first)) {
+			return false;
+		}
+		if (dash + 1 == end) {
+			last = size - 1;
+		}
+		else if (!parseRangeNumber(value, dash + 1, end, &last) || last < first) {
+			return false;
+		}
+
+		if (first < size) {
+			last = std::min(last, size - 1);
+			ranges.push_back(ByteRange{first, last - first + 1});
+		}
+	}
+	return anySpec;
+}
+
+
+//How much the client wants a content coding, from its Accept-Encoding header; 0 if it doesn't take it at all.
+float getEncodingQuality(const std::string& acceptEncoding, const std::string& coding) {
+	float wildcardQuality = 0;
+	size_t pos = 0;
+	while (pos < acceptEncoding.length()) {
+		size_t itemEnd = acceptEncoding.find(',', pos);
+		if (itemEnd == std::string::npos) {
+			itemEnd = acceptEncoding.length();
+		}
+		std::string item = boost::algorithm::trim_copy(acceptEncoding.substr(pos, itemEnd - pos));
+		pos = itemEnd + 1;
+
+		float quality = 1;
+		size_t paramStart = item.find(';');
+		if (paramStart != std::string::npos) {
+			std::string param = boost::algorithm::trim_copy(item.substr(paramStart + 1));
+			if (boost::algorithm::istarts_with(param, "q=")) {
+				quality = (float)atof(param.c_str() + 2);
+			}
+			item = boost::algorithm::trim_copy(item.substr(0, paramStart));
+		}
+
+		if (boost::algorithm::iequals(item, coding)) {
+			return quality;
+		}
+		if (item == "*") {
+			wildcardQuality = quality;
+		}
+	}
+	return wildcardQuality;
+}
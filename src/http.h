@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <vector>
 
 
 enum class HttpVerb
@@ -33,3 +34,13 @@ RouteVerb toRouteVerb(HttpVerb verb);
 RouteVerb toRouteVerb(std::string str);
 std::string httpVerbToString(HttpVerb value);
 std::string routeVerbToString(RouteVerb value);
+
+
+struct ByteRange
+{
+	unsigned long long offset;
+	unsigned long long length;
+};
+
+bool parseByteRanges(const std::string& value, unsigned long long size, std::vector<ByteRange>& ranges);
+float getEncodingQuality(const std::string& acceptEncoding, const std::string& coding);
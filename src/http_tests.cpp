@@ -0,0 +1,124 @@
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <vector>
+
+#include "http.h"
+
+using namespace std;
+
+
+static bool rangeIs(const ByteRange& range, unsigned long long offset, unsigned long long length) {
+	return range.offset == offset && range.length == length;
+}
+
+
+BOOST_AUTO_TEST_SUITE(mod_Http)
+
+BOOST_AUTO_TEST_CASE(func_parseByteRanges) {
+	vector<ByteRange> ranges;
+
+	BOOST_REQUIRE(parseByteRanges("bytes=0-99", 1000, ranges));
+	BOOST_REQUIRE_EQUAL(ranges.size(), 1u);
+	BOOST_CHECK(rangeIs(ranges[0], 0, 100));
+
+	//Open-ended, and past the end (clipped).
+	BOOST_REQUIRE(parseByteRanges("bytes=900-", 1000, ranges));
+	BOOST_CHECK(rangeIs(ranges[0], 900, 100));
+	BOOST_REQUIRE(parseByteRanges("bytes=900-5000", 1000, ranges));
+	BOOST_CHECK(rangeIs(ranges[0], 900, 100));
+
+	//Several, with whitespace and empty elements.
+	BOOST_REQUIRE(parseByteRanges("bytes= 0-0 , ,10-19,", 1000, ranges));
+	BOOST_REQUIRE_EQUAL(ranges.size(), 2u);
+	BOOST_CHECK(rangeIs(ranges[0], 0, 1));
+	BOOST_CHECK(rangeIs(ranges[1], 10, 10));
+}
+
+BOOST_AUTO_TEST_CASE(func_parseByteRangesSuffix) {
+	vector<ByteRange> ranges;
+
+	BOOST_REQUIRE(parseByteRanges("bytes=-100", 1000, ranges));
+	BOOST_REQUIRE_EQUAL(ranges.size(), 1u);
+	BOOST_CHECK(rangeIs(ranges[0], 900, 100));
+
+	//Longer than the file: the whole file.
+	BOOST_REQUIRE(parseByteRanges("bytes=-5000", 1000, ranges));
+	BOOST_CHECK(rangeIs(ranges[0], 0, 1000));
+
+	//The last 0 bytes can't be satisfied.
+	BOOST_REQUIRE(parseByteRanges("bytes=-0", 1000, ranges));
+	BOOST_CHECK(ranges.empty());
+}
+
+BOOST_AUTO_TEST_CASE(func_parseByteRangesUnsatisfiable) {
+	vector<ByteRange> ranges;
+
+	//Valid, but nothing in the file: 416.
+	BOOST_REQUIRE(parseByteRanges("bytes=1000-", 1000, ranges));
+	BOOST_CHECK(ranges.empty());
+	BOOST_REQUIRE(parseByteRanges("bytes=0-", 0, ranges));
+	BOOST_CHECK(ranges.empty());
+	BOOST_REQUIRE(parseByteRanges("bytes=-10", 0, ranges));
+	BOOST_CHECK(ranges.empty());
+
+	//Some satisfiable, some not: only those that are.
+	BOOST_REQUIRE(parseByteRanges("bytes=2000-3000,5-9", 1000, ranges));
+	BOOST_REQUIRE_EQUAL(ranges.size(), 1u);
+	BOOST_CHECK(rangeIs(ranges[0], 5, 5));
+}
+
+BOOST_AUTO_TEST_CASE(func_parseByteRangesInvalid) {
+	vector<ByteRange> ranges;
+
+	//Invalid headers are ignored (the whole file is sent).
+	BOOST_CHECK(!parseByteRanges("items=0-10", 1000, ranges));
+	BOOST_CHECK(!parseByteRanges("bytes=", 1000, ranges));
+	BOOST_CHECK(!parseByteRanges("bytes=,", 1000, ranges));
+	BOOST_CHECK(!parseByteRanges("bytes=10", 1000, ranges));
+	BOOST_CHECK(!parseByteRanges("bytes=20-10", 1000, ranges));
+	BOOST_CHECK(!parseByteRanges("bytes=a-10", 1000, ranges));
+	BOOST_CHECK(!parseByteRanges("bytes=0-10,x", 1000, ranges));
+	BOOST_CHECK(!parseByteRanges("bytes=-", 1000, ranges));
+
+	//Numbers too large for 64 bits.
+	BOOST_CHECK(!parseByteRanges("bytes=0-99999999999999999999", 1000, ranges));
+	BOOST_CHECK(!parseByteRanges("bytes=-99999999999999999999", 1000, ranges));
+	BOOST_REQUIRE(parseByteRanges("bytes=0-999999999999999999", 1000, ranges));
+	BOOST_CHECK(rangeIs(ranges[0], 0, 1000));
+}
+
+BOOST_AUTO_TEST_CASE(func_parseByteRangesMany) {
+	//All of them are parsed; the server decides that this many aren't worth serving.
+	string value = "bytes=";
+	for (int i = 0; i < 17; i++) {
+		value += (i == 0 ? "" : ",") + to_string(i * 10) + "-" + to_string(i * 10 + 4);
+	}
+	vector<ByteRange> ranges;
+	BOOST_REQUIRE(parseByteRanges(value, 1000, ranges));
+	BOOST_REQUIRE_EQUAL(ranges.size(), 17u);
+	BOOST_CHECK(rangeIs(ranges[16], 160, 5));
+}
+
+BOOST_AUTO_TEST_CASE(func_getEncodingQuality) {
+	BOOST_CHECK_EQUAL(getEncodingQuality("gzip, deflate, br", "gzip"), 1.0f);
+	BOOST_CHECK_EQUAL(getEncodingQuality("gzip, deflate, br", "br"), 1.0f);
+	BOOST_CHECK_EQUAL(getEncodingQuality("gzip, deflate", "br"), 0.0f);
+	BOOST_CHECK_EQUAL(getEncodingQuality("", "gzip"), 0.0f);
+
+	//Case and whitespace don't matter.
+	BOOST_CHECK_EQUAL(getEncodingQuality(" GZip ;q=0.5 ", "gzip"), 0.5f);
+	BOOST_CHECK_EQUAL(getEncodingQuality("br;q=0.8,gzip;q=0.9", "br"), 0.8f);
+
+	//q=0 means "not acceptable".
+	BOOST_CHECK_EQUAL(getEncodingQuality("gzip;q=0, br", "gzip"), 0.0f);
+	BOOST_CHECK_EQUAL(getEncodingQuality("gzip;q=0.000", "gzip"), 0.0f);
+
+	//The wildcard covers codings not named, but not those named explicitly.
+	BOOST_CHECK_EQUAL(getEncodingQuality("*", "br"), 1.0f);
+	BOOST_CHECK_EQUAL(getEncodingQuality("*;q=0.3", "gzip"), 0.3f);
+	BOOST_CHECK_EQUAL(getEncodingQuality("gzip;q=0, *", "gzip"), 0.0f);
+	BOOST_CHECK_EQUAL(getEncodingQuality("*, gzip;q=0", "gzip"), 0.0f);
+	BOOST_CHECK_EQUAL(getEncodingQuality("br, *;q=0", "gzip"), 0.0f);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
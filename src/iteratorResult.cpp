@@ -1,15 +1,39 @@
+#include <cstdint>
 #include "iteratorResult.h"
 
 #define DBG_DISABLE
 #include"dbg.h"
 
 IteratorResult::IteratorResult(PymlIterator iterator) {
+	streamBufferSize = 0;
+	streaming = false;
+	streamBufferStale = false;
 	exhaustIterator(iterator);
 }
 
+//Renders up to streamBufferSize bytes right away; if the page is longer, the rest is only rendered as it is read.
+//0 renders it all.
+IteratorResult::IteratorResult(PymlIterator iterator, size_t streamBufferSize) {
+	this->streamBufferSize = streamBufferSize;
+	streaming = false;
+	streamBufferStale = false;
+	totalLength = 0;
+	currentIdx = 0;
+
+	if (readIterator(iterator, streamBufferSize == 0 ? SIZE_MAX : streamBufferSize)) {
+		return;
+	}
+	streaming = true;
+	streamBufferStale = true;
+	pendingIterator = std::make_shared<PymlIterator>(iterator);
+}
+
 IteratorResult::IteratorResult(std::string fullString) {
 	strIterated.push_back(ValueOrPtr<std::string>(fullString));
 
+	streamBufferSize = 0;
+	streaming = false;
+	streamBufferStale = false;
 	currentIdx = 0;
 	totalLength = fullString.length();
 }
@@ -17,7 +41,16 @@ IteratorResult::IteratorResult(std::string fullString) {
 
 void IteratorResult::exhaustIterator(PymlIterator& iterator) {
 	totalLength = 0;
+	readIterator(iterator, SIZE_MAX);
+	currentIdx = 0;
+}
+
+//Returns true if the iterator ran out.
+bool IteratorResult::readIterator(PymlIterator& iterator, size_t maxLength) {
 	while (*iterator != NULL) {
+		if (totalLength >= maxLength) {
+			return false;
+		}
 		if (iterator.isTmpStr(*iterator)) {
 			strIterated.push_back(ValueOrPtr<std::string>(**iterator));
 			//DBG_FMT("added to storage: %1%", *strIterated[strIterated.size() - 1].get());
@@ -29,19 +62,57 @@ void IteratorResult::exhaustIterator(PymlIterator& iterator) {
 
 		++iterator;
 	}
-	currentIdx = 0;
+	return true;
+}
+
+//Renders the rest of the page in memory, so its length is known.
+void IteratorResult::finish() {
+	if (!streaming) {
+		return;
+	}
+	readIterator(*pendingIterator, SIZE_MAX);
+	pendingIterator.reset();
+	streaming = false;
+}
+
+//Gathers the next streamBufferSize bytes of the page; pieces are small, sending them one by one would be wasteful.
+void IteratorResult::fillStreamBuffer() {
+	streamBuffer.clear();
+	if (!pendingIterator) {
+		return;
+	}
+
+	PymlIterator& iterator = *pendingIterator;
+	while (*iterator != NULL && streamBuffer.length() < streamBufferSize) {
+		streamBuffer.append(**iterator);
+		++iterator;
+	}
+	if (*iterator == NULL) {
+		pendingIterator.reset();
+	}
 }
 
+//The stream buffer is only refilled when it's next read, so the last piece stays valid until then.
 const IteratorResult& IteratorResult::operator++() {
 	if (currentIdx < strIterated.size()) {
 		currentIdx++;
 	}
+	else if (streaming) {
+		streamBufferStale = true;
+	}
 	return *this;
 }
 
 const std::string* IteratorResult::operator*() {
 	if (currentIdx >= strIterated.size()) {
-		return NULL;
+		if (!streaming) {
+			return NULL;
+		}
+		if (streamBufferStale) {
+			fillStreamBuffer();
+			streamBufferStale = false;
+		}
+		return streamBuffer.empty() ? NULL : &streamBuffer;
 	}
 	return strIterated[currentIdx].get();
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include "pymlIterator.h"
 #include "valueOrPtr.h"
 
@@ -11,12 +12,39 @@ private:
 	size_t totalLength;
 	size_t currentIdx;
 
+	//Set while the rest of the page is rendered as the result is read, streamBufferSize bytes at a time.
+	std::shared_ptr<PymlIterator> pendingIterator;
+	size_t streamBufferSize;
+	std::string streamBuffer;
+	bool streamBufferStale;
+	bool streaming;
+
 	void exhaustIterator(PymlIterator& iterator);
+	bool readIterator(PymlIterator& iterator, size_t maxLength);
+	void fillStreamBuffer();
 
 public:
 	IteratorResult(PymlIterator iterator);
+	IteratorResult(PymlIterator iterator, size_t streamBufferSize);
 	IteratorResult(std::string fullString);
 
+	//False while the page is still rendering; the length is not known then.
+	bool isComplete() const {
+		return !streaming;
+	}
+
+	void finish();
+
+	//Pieces from a streamed page are only valid until the next one is read.
+	bool isPieceTransient(const std::string* piece) const {
+		return piece == &streamBuffer;
+	}
+
+	//True when reading past the current piece renders more of the page first.
+	bool isRenderingNext() const {
+		return streaming && currentIdx + 1 >= strIterated.size();
+	}
+
 	size_t getTotalLength() {
 		return totalLength;
 	}
@@ -1,6 +1,7 @@
 #include<boost/chrono.hpp>
 #include<poll.h>
 #include<unistd.h>
+#include<sys/uio.h>
 #include<string.h>
 #include<errno.h>
 #include"logger.h"
@@ -124,7 +125,13 @@ void LoggerIn::log(const char* buffer, size_t size) {
 		return;
 	}
 
-	if (write(pipeOut, buffer, size) != (int)size || write(pipeOut, "\n", 1) != 1) {
+	//One write per line, so lines from several processes and threads don't interleave.
+	iovec parts[2];
+	parts[0].iov_base = (void*)buffer;
+	parts[0].iov_len = size;
+	parts[1].iov_base = (void*)"\n";
+	parts[1].iov_len = 1;
+	if (writev(pipeOut, parts, 2) != (ssize_t)(size + 1)) {
 		fprintf(stderr, "Error in LoggerIn.write; errno %d\n", errno);
 	}
 }
@@ -1,7 +1,11 @@
 #include <unistd.h>
 #include <iostream>
 #include <string>
+#include <vector>
+#include <sched.h>
 #include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include "logger.h"
 #include "server.h"
@@ -15,6 +19,7 @@
 namespace bpo = boost::program_options;
 
 void startSetLoggers(std::string outFilename, std::string errFilename);
+bool parseCpuAffinity(std::string value, std::vector<int>& cpus);
 //TODO: get the stdout/stderr logger through a pipe too
 
 int main(int argc, char* argv[]) {
@@ -22,6 +27,11 @@ int main(int argc, char* argv[]) {
 	std::string stderrName;
 	int port;
 	std::string siteRoot;
+	ServerOptions serverOptions;
+	std::string cpuAffinity;
+	long maxWorkerRssMb;
+
+	serverOptions.commandLine.assign(argv, argv + argc);
 
 	bpo::options_description genericDesc("Generic options");
 	genericDesc.add_options()
@@ -30,6 +40,34 @@ int main(int argc, char* argv[]) {
 	bpo::options_description mainDesc("Krait options");
 	mainDesc.add_options()
 			("port,p", bpo::value<int>(&port)->required(), "Set port for server to run on")
+			("workers,w", bpo::value<int>(&serverOptions.workers)->default_value((int)sysconf(_SC_NPROCESSORS_ONLN)),
+			 "Set number of pre-forked worker processes (default is the number of CPUs; 0 forks a process for each connection)")
+			("min-workers", bpo::value<int>(&serverOptions.minWorkers)->default_value(0),
+			 "Let the pool shrink down to this many workers when idle (default is the number of workers)")
+			("max-workers", bpo::value<int>(&serverOptions.maxWorkers)->default_value(0),
+			 "Let the pool grow up to this many workers under load (default is the number of workers)")
+			("max-worker-requests", bpo::value<int>(&serverOptions.maxWorkerRequests)->default_value(0),
+			 "Replace a worker after it served this many requests (0 disables)")
+			("max-worker-age", bpo::value<int>(&serverOptions.maxWorkerAgeSec)->default_value(0),
+			 "Replace a worker after it ran for this many seconds (0 disables)")
+			("max-worker-rss", bpo::value<long>(&maxWorkerRssMb)->default_value(0),
+			 "Replace a worker once its resident memory reaches this many MB (0 disables)")
+			("max-pending", bpo::value<int>(&serverOptions.maxPending)->default_value(0),
+			 "Let the master admit clients, answering 503 once this many are waiting for a worker (or, without workers, being served) (0 disables)")
+			("queue-delay-target-ms", bpo::value<int>(&serverOptions.queueDelayTargetMs)->default_value(100),
+			 "With max-pending, also answer 503 while clients keep waiting longer than this for a worker")
+			("static-threads", bpo::value<int>(&serverOptions.staticThreads)->default_value(0),
+			 "Serve static files from this many threads in a process of their own, without forking or Python; other requests still go to the workers (0 disables)")
+			("no-request-fork", bpo::bool_switch(&serverOptions.noRequestFork),
+			 "Serve requests in the connection process, restoring the Python state between requests, instead of forking for each request")
+			("reuse-port", bpo::bool_switch(&serverOptions.reusePort),
+			 "Give each worker its own SO_REUSEPORT listening socket, letting the kernel balance connections between them")
+			("cpu-affinity", bpo::value<std::string>(&cpuAffinity)->default_value(""),
+			 "Pin workers to CPUs: \"auto\" for one CPU per worker, or a comma-separated list of CPUs to assign in order")
+			("accept-batch", bpo::value<int>(&serverOptions.acceptBatch)->default_value(64),
+			 "Set the maximum number of pending connections the master accepts at once")
+			("keep-alive-park-ms", bpo::value<int>(&serverOptions.keepAliveParkMs)->default_value(1000),
+			 "Hand keep-alive connections idle for this long back to the master, freeing their process (-1 disables)")
 			("stdout", bpo::value<std::string>(&stdoutName)->default_value("stdout"), "output logs (default is \"stdout\" for standard output)")
 			("stderr", bpo::value<std::string>(&stderrName)->default_value("stderr"), "error logs (default is \"stderr\" for standard error output)");
 
@@ -74,19 +112,98 @@ int main(int argc, char* argv[]) {
 		return 10;
 	}
 
+	if (serverOptions.workers < 0) {
+		std::cerr << "Invalid arguments: the number of workers can't be negative." << std::endl <<
+				"Run 'krait --help' for more information" << std::endl;
+		return 10;
+	}
+
+	if (serverOptions.acceptBatch < 1) {
+		std::cerr << "Invalid arguments: accept-batch must be at least 1." << std::endl <<
+				"Run 'krait --help' for more information" << std::endl;
+		return 10;
+	}
+
+	if (serverOptions.keepAliveParkMs < -1) {
+		std::cerr << "Invalid arguments: keep-alive-park-ms must be -1 (disabled) or at least 0." << std::endl <<
+				"Run 'krait --help' for more information" << std::endl;
+		return 10;
+	}
+
+	if (serverOptions.workers == 0 && (serverOptions.reusePort || cpuAffinity != "" ||
+		serverOptions.minWorkers != 0 || serverOptions.maxWorkers != 0)) {
+		std::cerr << "Invalid arguments: options reuse-port, cpu-affinity, min-workers and max-workers require workers." << std::endl <<
+				"Run 'krait --help' for more information" << std::endl;
+		return 10;
+	}
+
+	if (serverOptions.maxWorkerRequests < 0 || serverOptions.maxWorkerAgeSec < 0 || maxWorkerRssMb < 0) {
+		std::cerr << "Invalid arguments: worker recycling limits can't be negative." << std::endl <<
+				"Run 'krait --help' for more information" << std::endl;
+		return 10;
+	}
+	serverOptions.maxWorkerRssKb = maxWorkerRssMb * 1024;
+
+	if (serverOptions.maxPending < 0 || serverOptions.queueDelayTargetMs < 1) {
+		std::cerr << "Invalid arguments: max-pending can't be negative and queue-delay-target-ms must be positive." << std::endl <<
+				"Run 'krait --help' for more information" << std::endl;
+		return 10;
+	}
+
+	if (serverOptions.maxPending > 0 && serverOptions.reusePort) {
+		std::cerr << "Invalid arguments: max-pending needs the master to accept, so it can't be used with reuse-port." << std::endl <<
+				"Run 'krait --help' for more information" << std::endl;
+		return 10;
+	}
+
+	if (serverOptions.staticThreads < 0) {
+		std::cerr << "Invalid arguments: static-threads can't be negative." << std::endl <<
+				"Run 'krait --help' for more information" << std::endl;
+		return 10;
+	}
+
+	if (serverOptions.staticThreads > 0 && serverOptions.reusePort) {
+		std::cerr << "Invalid arguments: static-threads needs the master to accept, so it can't be used with reuse-port." << std::endl <<
+				"Run 'krait --help' for more information" << std::endl;
+		return 10;
+	}
+
+	if (serverOptions.minWorkers == 0) {
+		serverOptions.minWorkers = serverOptions.workers;
+	}
+	if (serverOptions.maxWorkers == 0) {
+		serverOptions.maxWorkers = serverOptions.workers;
+	}
+	if (serverOptions.minWorkers < 0 || serverOptions.minWorkers > serverOptions.workers ||
+		serverOptions.maxWorkers < serverOptions.workers) {
+		std::cerr << "Invalid arguments: min-workers <= workers <= max-workers must hold." << std::endl <<
+				"Run 'krait --help' for more information" << std::endl;
+		return 10;
+	}
+
+	if (!parseCpuAffinity(cpuAffinity, serverOptions.cpuAffinity)) {
+		std::cerr << "Invalid arguments: cpu-affinity must be \"auto\" or a comma-separated list of CPU numbers." << std::endl <<
+				"Run 'krait --help' for more information" << std::endl;
+		return 10;
+	}
+
 	if (stdoutName != "stdout" && stderrName != "stderr") {
 		startSetLoggers(stdoutName, stderrName);
 	}
 
 
 	startCommanderProcess();
+
+	//Workers are long-lived, don't let a client that closed its connection early kill them.
+	signal(SIGPIPE, SIG_IGN);
 	
 	SignalManager::registerSignal(std::move(std::unique_ptr<ShtudownSignalHandler>(new ShtudownSignalHandler())));
 	SignalManager::registerSignal(std::move(std::unique_ptr<StopSignalHandler>(new StopSignalHandler())));
 	SignalManager::registerSignal(std::move(std::unique_ptr<KillSignalHandler>(new KillSignalHandler())));
+	SignalManager::registerSignal(std::move(std::unique_ptr<ReloadSignalHandler>(new ReloadSignalHandler())));
 
 	try {
-		Server server(siteRoot, port);
+		Server server(siteRoot, port, serverOptions);
 
 		server.runServer();
 	}
@@ -142,3 +259,33 @@ void startSetLoggers(std::string outFilename, std::string errFilename) {
 	close(infoPipe[1]);
 	close(errPipe[1]);
 }
+
+bool parseCpuAffinity(std::string value, std::vector<int>& cpus) {
+	cpus.clear();
+	if (value == "") {
+		return true;
+	}
+	if (value == "auto") {
+		int nrCpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+		for (int i = 0; i < nrCpus; i++) {
+			cpus.push_back(i);
+		}
+		return true;
+	}
+
+	std::vector<std::string> parts;
+	boost::split(parts, value, boost::is_any_of(","));
+	for (const auto& part : parts) {
+		try {
+			int cpu = boost::lexical_cast<int>(boost::trim_copy(part));
+			if (cpu < 0 || cpu >= CPU_SETSIZE) {
+				return false;
+			}
+			cpus.push_back(cpu);
+		}
+		catch (const boost::bad_lexical_cast&) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -28,6 +28,11 @@ int main(int argc, char* argv[]) {
 			sendCommandKill();
 			printf("Kill sent.\n");
 		}
+		else if (std::string(argv[1]) == "reload") {
+			argsOk = true;
+			sendCommandReload();
+			printf("Reload sent.\n");
+		}
 		else if (std::string(argv[1]) == "watch") {
 			argsOk = true;
 			watchKrait();
@@ -138,5 +143,6 @@ void printUsage() {
 	printf("krait-cmdr start {args}: start krait with given arguments.\n");
 	printf("krait-cmdr stop: sends graceful close signal to krait.\n");
 	printf("krait-cmdr kill: sends force close signal to krait.\n");
+	printf("krait-cmdr reload: starts a new krait with the same arguments on the same socket, then gracefully closes the old one.\n");
 	printf("krait-cmdr watch: watch krait logs (equivalent to \"tail -f {stdout-path} -f {stderr_path}\")\n");
 }
@@ -3,6 +3,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <errno.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -12,6 +13,11 @@
 #include <string.h>
 #include <poll.h>
 #include <endian.h>
+#include <climits>
+#include <deque>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
 #include "logger.h"
 #include "network.h"
 #include "utils.h"
@@ -22,7 +28,7 @@
 #include "dbg.h"
 
 
-int getServerSocket(int port, bool setListen, bool reuseAddr) {
+int getServerSocket(int port, bool setListen, bool reuseAddr, bool reusePort) {
 	sockaddr_in serverSockaddr;
 	memzero(serverSockaddr);
 
@@ -40,6 +46,13 @@ int getServerSocket(int port, bool setListen, bool reuseAddr) {
 		BOOST_THROW_EXCEPTION(networkError() << stringInfo("getListenSocket: coult not set reuseAddr.") << errcodeInfoDef());
 	}
 
+	if (reusePort) {
+		int enablePort = 1;
+		if (setsockopt(sd, SOL_SOCKET, SO_REUSEPORT, &enablePort, sizeof(enablePort)) == -1) {
+			BOOST_THROW_EXCEPTION(networkError() << stringInfo("getListenSocket: could not set reusePort.") << errcodeInfoDef());
+		}
+	}
+
 	if (bind(sd, (sockaddr*)&serverSockaddr, sizeof(sockaddr)) != 0) {
 		BOOST_THROW_EXCEPTION(networkError() << stringInfo("getListenSocket: could not bind socket") << errcodeInfoDef());
 	}
@@ -61,6 +74,19 @@ void setSocketListen(int sd) {
 	}
 }
 
+//Returns how many connections are waiting to be accepted on a listening socket (0 if unknown).
+int getListenQueueLength(int sd) {
+	tcp_info info;
+	memzero(info);
+	socklen_t infoLen = sizeof(info);
+
+	//For listening sockets, Linux reports the accept queue length as tcpi_unacked.
+	if (getsockopt(sd, IPPROTO_TCP, TCP_INFO, &info, &infoLen) == -1 || info.tcpi_state != TCP_LISTEN) {
+		return 0;
+	}
+	return (int)info.tcpi_unacked;
+}
+
 
 int getNewClient(int listenerSocket, int timeout) {
 	sockaddr_in clientSockaddr;
@@ -73,6 +99,9 @@ int getNewClient(int listenerSocket, int timeout) {
 
 	int pollResult = poll(&pfd, 1, timeout);
 	if (pollResult == -1) {
+		if (errno == EINTR) {
+			return -1;
+		}
 		BOOST_THROW_EXCEPTION(networkError() << stringInfo("poll(): getting new client.") << errcodeInfoDef());
 	}
 	if (pollResult == 0) {
@@ -80,10 +109,10 @@ int getNewClient(int listenerSocket, int timeout) {
 	}
 
 	socklen_t sockaddrLen = sizeof(clientSockaddr);
-	int client = accept(listenerSocket, (sockaddr*)&clientSockaddr, &sockaddrLen);
+	int client = accept4(listenerSocket, (sockaddr*)&clientSockaddr, &sockaddrLen, SOCK_CLOEXEC);
 
 	if (client < 0) {
-		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED || errno == EINTR) {
 			return -1;
 		}
 
@@ -93,10 +122,98 @@ int getNewClient(int listenerSocket, int timeout) {
 	return client;
 }
 
+//Accepts clients until there are no more pending (or maxClients were accepted), without waiting.
+std::vector<int> getNewClients(int listenerSocket, int maxClients) {
+	std::vector<int> clients;
+	sockaddr_in clientSockaddr;
+
+	while ((int)clients.size() < maxClients) {
+		socklen_t sockaddrLen = sizeof(clientSockaddr);
+		int client = accept4(listenerSocket, (sockaddr*)&clientSockaddr, &sockaddrLen, SOCK_CLOEXEC);
+
+		if (client < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			if (errno == ECONNABORTED || errno == EINTR) {
+				continue;
+			}
+			if (clients.size() != 0) {
+				//Don't lose the clients we already have; the error will come up again on the next call.
+				break;
+			}
+
+			BOOST_THROW_EXCEPTION(networkError() << stringInfo("getNewClients: could not accept new client") << errcodeInfoDef());
+		}
+
+		clients.push_back(client);
+	}
+
+	return clients;
+}
+
 void closeSocket(int clientSocket) {
 	close(clientSocket);
 }
 
+//Returns true if the socket has something to read (or an error to report) within timeoutMs.
+bool waitSocketReadable(int clientSocket, int timeoutMs) {
+	pollfd pfd;
+	pfd.fd = clientSocket;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	int pollResult = poll(&pfd, 1, timeoutMs);
+	if (pollResult == -1) {
+		if (errno == EINTR) {
+			return true; //Let the caller's regular read path deal with it.
+		}
+		BOOST_THROW_EXCEPTION(networkError() << stringInfo("poll(): waiting for socket to be readable.") << errcodeInfoDef());
+	}
+	return pollResult != 0;
+}
+
+//Returns 1 if the client has sent data, 0 if there is nothing to read yet, and -1 if the connection is closed.
+int peekSocketState(int clientSocket) {
+	char byte;
+	ssize_t result = recv(clientSocket, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+	if (result > 0) {
+		return 1;
+	}
+	if (result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+		return 0;
+	}
+	return -1;
+}
+
+
+//Discards whatever the client sent so far. Returns false once the client is done sending (or gone).
+bool drainSocket(int clientSocket) {
+	char buffer[4096];
+	while (true) {
+		ssize_t received = recv(clientSocket, buffer, sizeof(buffer), MSG_DONTWAIT);
+		if (received > 0) {
+			continue;
+		}
+		return received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+	}
+}
+
+//Closing a socket with request data unread makes the kernel reset the connection, and the client may lose
+//the response it hasn't read yet. This stops sending, then discards what the client still sends, for a while.
+void drainBeforeClose(int clientSocket) {
+	const long long lingerMs = 2000;
+	shutdown(clientSocket, SHUT_WR);
+
+	long long endMs = getMonotonicMs() + lingerMs;
+	long long leftMs;
+	while ((leftMs = endMs - getMonotonicMs()) > 0) {
+		if (!waitSocketReadable(clientSocket, (int)leftMs) || !drainSocket(clientSocket)) {
+			return;
+		}
+	}
+}
+
 
 void printSocket(int clientSocket) {
 	char data[4096];
@@ -111,17 +228,110 @@ void printSocket(int clientSocket) {
 	}
 }
 
-boost::optional<Request> getRequestFromSocket(int clientSocket, int timeoutMs) {
-	RequestParser parser;
-	char buffer[4096];
+void respondWithCString(int clientSocket, const char* response);
+void respondWithBuffer(int clientSocket, const char* response, size_t size);
+
+static int sendTimeoutMs = -1;
+
+//How long a client may take no data before it's dropped; -1 waits forever.
+void setSendTimeout(int timeoutMs) {
+	sendTimeoutMs = timeoutMs;
+}
+
+//Waits for room in the socket's send buffer, instead of retrying the send in a loop.
+static void waitSocketWritable(int clientSocket) {
+	pollfd pfd;
+	pfd.fd = clientSocket;
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+
 	int pollResult;
+	while ((pollResult = poll(&pfd, 1, sendTimeoutMs)) < 0 && errno == EINTR) {
+	}
+	if (pollResult < 0) {
+		BOOST_THROW_EXCEPTION(networkError() << stringInfo("poll(): waiting to send to client.") << errcodeInfoDef());
+	}
+	if (pollResult == 0) {
+		Loggers::logErr(formatString("Slow client: took no data for %1% ms, dropping it.", sendTimeoutMs));
+		BOOST_THROW_EXCEPTION(networkError() << stringInfo("Send timeout: client not reading."));
+	}
+}
+
+//Returns -1 if the request was answered with 413, for a chunked body past the limit.
+static int consumeRequestData(int clientSocket, RequestParser& parser, char* data, int dataLen) {
+	try {
+		return parser.consume(data, dataLen);
+	}
+	catch (bodyTooLargeError&) {
+		Loggers::logInfo("Chunked request body over the size limit, turned down with 413.");
+		respondWithObject(clientSocket, Response(413, "", true));
+		drainBeforeClose(clientSocket);
+		return -1;
+	}
+	catch (httpParseError err) {
+		Loggers::logErr(formatString("Error parsing http request: %s\n", err.what()));
+		BOOST_THROW_EXCEPTION(networkError() << stringInfo("Error parsing HTTP request"));
+	}
+}
+
+//Shows the head to headHandler before the body is read; returns false if the request was turned down.
+static bool checkRequestHead(int clientSocket, RequestParser& parser, const RequestHeadHandler& headHandler) {
+	int status = headHandler(parser.getRequestHead(), parser.getBodyLength());
+	if (status >= 400) {
+		Loggers::logInfo(formatString("Request turned down with %1% before reading its body.", status));
+		respondWithObject(clientSocket, Response(status, "", true));
+		drainBeforeClose(clientSocket);
+		return false;
+	}
+	//No use asking for a body that is already here.
+	if (status == 100 && !parser.isFinished()) {
+		respondWithCString(clientSocket, "HTTP/1.1 100 Continue\r\n\r\n");
+	}
+	return true;
+}
+
+//pendingData holds bytes read past the previous request (pipelined requests); they are used first,
+//and whatever is read past this request is left there for the next one.
+//Bodies larger than bodySpillThreshold (if not 0) are kept in a file instead of in memory.
+//Chunked bodies that pass maxBodySize (if not 0) are answered with 413 and none is returned.
+//If the request has a body, headHandler sees the head first (see RequestHeadHandler); if it turns the request down,
+//the connection is answered and none is returned.
+boost::optional<Request> getRequestFromSocket(int clientSocket, int timeoutMs, std::string& pendingData,
+                                              size_t bodySpillThreshold, unsigned long long maxBodySize,
+                                              const RequestHeadHandler& headHandler) {
+	RequestParser parser(bodySpillThreshold, maxBodySize);
+	char buffer[65536];
+	int pollResult;
+	bool headChecked = false;
 
 	pollfd pfd;
 	pfd.fd = clientSocket;
 	pfd.events = POLLIN;
 	pfd.revents = 0;
 
-	while (!parser.isFinished() && (pollResult = poll(&pfd, 1, timeoutMs)) != 0) {
+	if (!pendingData.empty()) {
+		int bytesUsed = consumeRequestData(clientSocket, parser, &pendingData[0], (int)pendingData.length());
+		if (bytesUsed == -1) {
+			pendingData.clear();
+			return boost::none;
+		}
+		pendingData.erase(0, bytesUsed);
+	}
+
+	while (true) {
+		if (!headChecked && parser.isHeadFinished() && parser.hasBody() && headHandler) {
+			headChecked = true;
+			if (!checkRequestHead(clientSocket, parser, headHandler)) {
+				pendingData.clear();
+				return boost::none;
+			}
+		}
+		if (parser.isFinished()) {
+			break;
+		}
+		if ((pollResult = poll(&pfd, 1, timeoutMs)) == 0) {
+			break;
+		}
 		if (pollResult < 0) {
 			BOOST_THROW_EXCEPTION(networkError() << stringInfo("poll(): waiting for request from socket."));
 		}
@@ -139,13 +349,12 @@ boost::optional<Request> getRequestFromSocket(int clientSocket, int timeoutMs) {
 		}
 
 		if (bytesRead != 0) {
-			try {
-				parser.consume(buffer, bytesRead);
-			}
-			catch (httpParseError err) {
-				Loggers::logErr(formatString("Error parsing http request: %s\n", err.what()));
-				BOOST_THROW_EXCEPTION(networkError() << stringInfo("Error parsing HTTP request"));
+			int bytesUsed = consumeRequestData(clientSocket, parser, buffer, bytesRead);
+			if (bytesUsed == -1) {
+				pendingData.clear();
+				return boost::none;
 			}
+			pendingData.assign(buffer + bytesUsed, bytesRead - bytesUsed);
 		}
 	}
 
@@ -181,6 +390,53 @@ bool readExactly(int clientSocket, void* dst, size_t nrBytes) {
 }
 
 
+//Parses a request head already waiting on the socket, leaving it there. *headLength is 0 if the whole head
+//hasn't arrived yet; otherwise it's the head's length, and the request is only returned if it has no body.
+boost::optional<Request> peekRequestHead(int clientSocket, size_t* headLength) {
+	const size_t maxPeekLength = 8192;
+	const char headEnd[] = "\r\n\r\n";
+	char buffer[maxPeekLength];
+	*headLength = 0;
+
+	ssize_t peeked = recv(clientSocket, buffer, sizeof(buffer), MSG_PEEK | MSG_DONTWAIT);
+	if (peeked <= 0) {
+		return boost::none;
+	}
+	char* headEndIt = std::search(buffer, buffer + peeked, headEnd, headEnd + 4);
+	if (headEndIt == buffer + peeked) {
+		return boost::none;
+	}
+	*headLength = (size_t)(headEndIt - buffer) + 4;
+
+	try {
+		RequestParser parser;
+		parser.consume(buffer, (int)*headLength);
+		if (parser.isFinished()) {
+			return parser.getRequest();
+		}
+	}
+	catch (httpParseError&) {
+		//Whoever reads it for real answers the error.
+	}
+	return boost::none;
+}
+
+//Takes data seen with peekRequestHead off the socket.
+void discardSocketData(int clientSocket, size_t length) {
+	char buffer[4096];
+	while (length != 0) {
+		ssize_t received = recv(clientSocket, buffer, std::min(length, sizeof(buffer)), MSG_DONTWAIT);
+		if (received <= 0) {
+			if (received == -1 && errno == EINTR) {
+				continue;
+			}
+			BOOST_THROW_EXCEPTION(networkError() << stringInfo("recv(): discarding peeked request data.") << errcodeInfoDef());
+		}
+		length -= (size_t)received;
+	}
+}
+
+
 WebsocketsFrame getWebsocketsFrame(int clientSocket) {
 	WebsocketsFrame result;
 
@@ -278,69 +534,35 @@ boost::optional<WebsocketsFrame> getWebsocketsFrameTimeout(int clientSocket, int
 
 
 void sendWebsocketsFrame(int clientSocket, WebsocketsFrame& frame) {
-	uint8_t firstByte = 0;
+	uint8_t header[10];
+	size_t headerLength = 2;
 	uint64_t msgLen = frame.message.length();
 
+	header[0] = (uint8_t)frame.opcode;
 	if (frame.isFin) {
-		firstByte |= 0x80;
+		header[0] |= 0x80;
 	}
 
-	firstByte |= (uint8_t)frame.opcode;
-	if (write(clientSocket, &firstByte, 1) != 1) {
-		BOOST_THROW_EXCEPTION(networkError() << stringInfo("Could not write Websockets frame (first byte)")
-			<< errcodeInfoDef());
-	}
 	if (msgLen < 126) {
-		uint8_t secondByte = (uint8_t)msgLen;
-		if (write(clientSocket, &secondByte, 1) != 1) {
-			BOOST_THROW_EXCEPTION(networkError() << stringInfo("Could not write Websockets frame (length < 126)")
-				<< errcodeInfoDef());
-		}
+		header[1] = (uint8_t)msgLen;
 	}
 	else if (msgLen <= 0xFFFF) {
-		uint8_t secondByte = 126;
+		header[1] = 126;
 		uint16_t lenWord = htons((uint16_t)msgLen);
-		if (write(clientSocket, &secondByte, 1) != 1 || write(clientSocket, &lenWord, 2) != 2) {
-			BOOST_THROW_EXCEPTION(networkError() << stringInfo("Could not write Websockets frame (126 <= length <= 65535")
-				<< errcodeInfoDef());
-		}
+		memcpy(header + 2, &lenWord, 2);
+		headerLength += 2;
 	}
 	else {
-		uint8_t secondByte = 126;
+		header[1] = 127;
 		uint64_t lenQword = htobe64(msgLen);
-		if (write(clientSocket, &secondByte, 1) != 1 || write(clientSocket, &lenQword, 8) != 8) {
-			BOOST_THROW_EXCEPTION(networkError() << stringInfo("Could not write Websockets frame (length > 65535")
-				<< errcodeInfoDef());
-		}
+		memcpy(header + 2, &lenQword, 8);
+		headerLength += 8;
 	}
 
-	const char* data = frame.message.c_str();
-	const size_t blockSize = 65536;
-	size_t lenLeft = frame.message.length();
-	while (lenLeft > 0) {
-		size_t bytesToWrite = blockSize;
-		if (lenLeft < bytesToWrite) {
-			bytesToWrite = lenLeft;
-		}
-
-		int bytesWritten = write(clientSocket, data, bytesToWrite);
-		if (bytesWritten < 0) {
-			if (errno == EAGAIN || errno == EWOULDBLOCK) {
-				bytesWritten = 0;
-			}
-			else {
-				BOOST_THROW_EXCEPTION(networkError() << stringInfo("Could not read Webockets frame: payload missing / partial")
-					<< errcodeInfoDef());
-			}
-		}
-		lenLeft -= bytesWritten;
-		data += bytesWritten;
-	}
+	respondWithBuffer(clientSocket, (const char*)header, headerLength);
+	respondWithBuffer(clientSocket, frame.message.data(), frame.message.length());
 }
 
-void respondWithCString(int clientSocket, const char* response);
-void respondWithBuffer(int clientSocket, const char* response, size_t size);
-
 
 void respondRequestHttp10(int clientSocket) {
 	respondWithCString(clientSocket, "HTTP/1.0 505 Version Not Supported\r\nConnection:Close\r\n\r\n");
@@ -356,50 +578,223 @@ void respondRequest200(int clientSocket) {
 	respondWithCString(clientSocket, "HTTP/1.0 200 OK\r\nConnection:Close\r\n\r\n");
 }
 
-void respondWithObjectRef(int clientSocket, Response& response) {
-	std::string responseData = response.getResponseHeaders();
+//Gathers the pieces of a response and sends them with as few sendmsg() calls as possible.
+//Pieces must stay valid until they are flushed; addCopy keeps its own copy.
+class GatherWriter
+{
+	static const size_t maxPendingLength = 262144;
+
+	int clientSocket;
+	std::vector<iovec> pending;
+	size_t pendingLength;
+	std::deque<std::string> copies;
+	bool corked;
+
+	void setCork(bool cork) {
+		int value = cork ? 1 : 0;
+		//Only an optimization, don't fail on it.
+		setsockopt(clientSocket, IPPROTO_TCP, TCP_CORK, &value, sizeof(value));
+		corked = cork;
+	}
+
+public:
+	explicit GatherWriter(int clientSocket)
+		: clientSocket(clientSocket), pendingLength(0), corked(false) {
+	}
+
+	//Uncorking sends whatever the kernel still holds.
+	~GatherWriter() {
+		if (corked) {
+			setCork(false);
+		}
+	}
+
+	void add(const char* data, size_t length) {
+		if (length == 0) {
+			return;
+		}
+		pending.push_back(iovec{(void*)data, length});
+		pendingLength += length;
+		if (pending.size() >= IOV_MAX || pendingLength >= maxPendingLength) {
+			flush(false);
+		}
+	}
+
+	void addCopy(const char* data, size_t length) {
+		copies.emplace_back(data, length);
+		add(copies.back().data(), length);
+	}
 
-	respondWithBuffer(clientSocket, responseData.c_str(), responseData.length());
+	//Responses that take more than one sendmsg() are corked, so their pieces don't go out as small segments.
+	void flush(bool last) {
+		if (!last && !corked) {
+			setCork(true);
+		}
+
+		size_t idx = 0;
+		while (idx < pending.size()) {
+			int count = (int)std::min(pending.size() - idx, (size_t)IOV_MAX);
+			msghdr message;
+			memzero(message);
+			message.msg_iov = &pending[idx];
+			message.msg_iovlen = count;
+
+			ssize_t written = sendmsg(clientSocket, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+			if (written < 0) {
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					waitSocketWritable(clientSocket);
+					continue;
+				}
+				if (errno == EINTR) {
+					continue;
+				}
+				BOOST_THROW_EXCEPTION(networkError() << stringInfo("respondWith: could not send response.") << errcodeInfoDef());
+			}
+
+			//Skip what went out; the last piece may have gone out partially.
+			while (idx < pending.size() && (size_t)written >= pending[idx].iov_len) {
+				written -= pending[idx].iov_len;
+				idx++;
+			}
+			if (written != 0) {
+				pending[idx].iov_base = (char*)pending[idx].iov_base + written;
+				pending[idx].iov_len -= written;
+			}
+		}
+
+		pending.clear();
+		pendingLength = 0;
+		copies.clear();
+		if (last && corked) {
+			setCork(false);
+		}
+	}
+};
+
+//Each piece of the body goes out as one chunk.
+static void respondWithChunks(GatherWriter& writer, Response& response) {
+	char sizeLine[32];
 
-	//DBG("getting first bodyNext");
 	const std::string* bodyNext = response.getBodyNext();
 	while (bodyNext != NULL) {
-		//DBG_FMT("sending body: std::string ptr is %p, body is %p, len is %d", bodyNext, bodyNext->c_str(), bodyNext->length());
-
-		respondWithBuffer(clientSocket, bodyNext->c_str(), bodyNext->length());
-		//DBG("bodyNext sent, getting next");
+		//An empty chunk would end the body.
+		if (!bodyNext->empty()) {
+			int sizeLength = snprintf(sizeLine, sizeof(sizeLine), "%zx\r\n", bodyNext->length());
+			writer.addCopy(sizeLine, sizeLength);
+			writer.add(bodyNext->data(), bodyNext->length());
+			writer.add("\r\n", 2);
+		}
+		//A streamed piece is replaced by the next one.
+		if (response.isBodyPieceTransient(bodyNext)) {
+			writer.flush(false);
+		}
 		bodyNext = response.getBodyNext();
+	}
+
+	writer.add("0\r\n\r\n", 5);
+}
 
+//The kernel copies the file to the socket; it never goes through our memory.
+//sendfile() has no MSG_DONTWAIT, so the socket is non-blocking while it runs.
+static void sendFileNonBlocking(int clientSocket, int fd, off_t offset, size_t length) {
+	while (length != 0) {
+		ssize_t sent = sendfile(clientSocket, fd, &offset, length);
+		if (sent < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				waitSocketWritable(clientSocket);
+				continue;
+			}
+			if (errno == EINTR) {
+				continue;
+			}
+			BOOST_THROW_EXCEPTION(networkError() << stringInfo("sendfile(): could not send response file.") << errcodeInfoDef());
+		}
+		if (sent == 0) {
+			//The file shrank since the headers were made; the client can't get what they promised.
+			BOOST_THROW_EXCEPTION(networkError() << stringInfo("sendfile(): response file truncated while sending."));
+		}
+		length -= sent;
 	}
 }
 
+static void respondWithFile(int clientSocket, int fd, off_t offset, size_t length) {
+	int flags = fcntl(clientSocket, F_GETFL);
+	if (flags == -1 || fcntl(clientSocket, F_SETFL, flags | O_NONBLOCK) == -1) {
+		BOOST_THROW_EXCEPTION(networkError() << stringInfo("fcntl(): making client socket non-blocking.") << errcodeInfoDef());
+	}
+
+	try {
+		sendFileNonBlocking(clientSocket, fd, offset, length);
+	}
+	catch (...) {
+		fcntl(clientSocket, F_SETFL, flags);
+		throw;
+	}
+	fcntl(clientSocket, F_SETFL, flags);
+}
+
+void respondWithObjectRef(int clientSocket, Response& response) {
+	std::string responseData = response.getResponseHeaders();
+	GatherWriter writer(clientSocket);
+
+	writer.add(responseData.data(), responseData.length());
+
+	if (response.isBodyChunked()) {
+		respondWithChunks(writer, response);
+	}
+	else if (response.getBodyFile() != NULL) {
+		for (const FilePart& part : response.getBodyFileParts()) {
+			writer.add(part.prefix.data(), part.prefix.length());
+			//Corked, so the text before the range leaves with its start.
+			writer.flush(false);
+			respondWithFile(clientSocket, response.getBodyFile()->getFd(), part.offset, part.length);
+		}
+		writer.add(response.getBodyFileSuffix().data(), response.getBodyFileSuffix().length());
+	}
+	else {
+		const std::string* bodyNext = response.getBodyNext();
+		while (bodyNext != NULL) {
+			writer.add(bodyNext->data(), bodyNext->length());
+			bodyNext = response.getBodyNext();
+		}
+	}
+
+	writer.flush(true);
+}
+
 void respondWithObject(int clientSocket, Response response) {
 	respondWithObjectRef(clientSocket, response);
 }
 
 
+//Sends a canned response without waiting, then stops sending. The socket is left open: closing it
+//while the request is still arriving would reset the connection, so the caller keeps draining it before closing.
+void rejectClient(int clientSocket, const std::string& response) {
+	drainSocket(clientSocket);
+	send(clientSocket, response.c_str(), response.length(), MSG_DONTWAIT | MSG_NOSIGNAL);
+	shutdown(clientSocket, SHUT_WR);
+}
+
+
 void respondWithCString(int clientSocket, const char* response) {
 	respondWithBuffer(clientSocket, response, strlen(response));
 }
 
 
 void respondWithBuffer(int clientSocket, const char* response, size_t size) {
-	//DBG("inRespondWithBuffer");
 	size_t lenLeft = size;
-	const size_t maxBlockSize = 65536;
 
 	while (lenLeft > 0) {
-		size_t lenCurrent = std::min(maxBlockSize, lenLeft);
-		//DBG_FMT("sending buffer one, %d bytes from ptr %p", lenCurrent, response);
-		int writeOut = write(clientSocket, response, lenCurrent);
+		ssize_t writeOut = send(clientSocket, response, lenLeft, MSG_DONTWAIT | MSG_NOSIGNAL);
 		if (writeOut < 0) {
 			if (errno == EAGAIN || errno == EWOULDBLOCK) {
-				writeOut = 0;
-				//DBG("eagain/wouldblock");
+				waitSocketWritable(clientSocket);
+				continue;
 			}
-			else {
-				BOOST_THROW_EXCEPTION(networkError() << stringInfo("respondWith: could not send response.") << errcodeInfoDef());
+			if (errno == EINTR) {
+				continue;
 			}
+			BOOST_THROW_EXCEPTION(networkError() << stringInfo("respondWith: could not send response.") << errcodeInfoDef());
 		}
 		response += writeOut;
 		lenLeft -= writeOut;
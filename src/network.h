@@ -1,5 +1,7 @@
 #pragma once
 #include<string>
+#include<vector>
+#include<functional>
 #include<boost/optional.hpp>
 
 #include"request.h"
@@ -7,13 +9,29 @@
 #include"websocketsTypes.h"
 
 
-int getServerSocket(int port, bool setListen, bool reuseAddr);
+int getServerSocket(int port, bool setListen, bool reuseAddr, bool reusePort = false);
 void setSocketListen(int sd);
+int getListenQueueLength(int sd);
 int getNewClient(int listenerSocket, int timeoutMs);
+std::vector<int> getNewClients(int listenerSocket, int maxClients);
 void closeSocket(int clientSocket);
+bool waitSocketReadable(int clientSocket, int timeoutMs);
+int peekSocketState(int clientSocket);
+bool drainSocket(int clientSocket);
+void drainBeforeClose(int clientSocket);
 
 void printSocket(int clientSocket);
-boost::optional<Request> getRequestFromSocket(int clientSocket, int timeoutMs);
+
+//Sees the head of a request with a body, before the body is read. Returns 0 to read the body,
+//100 to send "100 Continue" first, or an error status (>= 400) to answer with it and leave the body unread.
+//bodyLength is 0 for chunked bodies. The head is only valid during the call.
+typedef std::function<int(const Request& head, unsigned long long bodyLength)> RequestHeadHandler;
+
+boost::optional<Request> getRequestFromSocket(int clientSocket, int timeoutMs, std::string& pendingData,
+                                             size_t bodySpillThreshold, unsigned long long maxBodySize,
+                                             const RequestHeadHandler& headHandler);
+boost::optional<Request> peekRequestHead(int clientSocket, size_t* headLength);
+void discardSocketData(int clientSocket, size_t length);
 
 WebsocketsFrame getWebsocketsFrame(int clientSocket);
 boost::optional<WebsocketsFrame> getWebsocketsFrameTimeout(int clientSocket, int timeoutMs);
@@ -24,3 +42,5 @@ void respondRequest404(int clientSocket);
 void respondRequest200(int clientSocket);
 void respondWithObjectRef(int clientSocket, Response& response);
 void respondWithObject(int clientSocket, Response response);
+void rejectClient(int clientSocket, const std::string& response);
+void setSendTimeout(int timeoutMs);
@@ -0,0 +1,84 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "openFile.h"
+#include "utils.h"
+#include "except.h"
+
+#define DBG_DISABLE
+#include "dbg.h"
+
+
+OpenFile::OpenFile(const std::string& filename, bool findVariants)
+	: path(filename), findsVariants(findVariants) {
+	fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		if (errno == ENOENT || errno == ENOTDIR) {
+			BOOST_THROW_EXCEPTION(notFoundError() << stringInfoFromFormat("Error: File not found: %1%", filename));
+		}
+		BOOST_THROW_EXCEPTION(syscallError() << stringInfoFromFormat("open(): opening file %1%", filename) << errcodeInfoDef());
+	}
+
+	struct stat statResult;
+	if (fstat(fd, &statResult) != 0) {
+		close(fd);
+		BOOST_THROW_EXCEPTION(syscallError() << stringInfoFromFormat("fstat(): opening file %1%", filename) << errcodeInfoDef());
+	}
+
+	inode = statResult.st_ino;
+	size = statResult.st_size;
+	modifiedTime = statResult.st_mtime;
+	char tagBuffer[33];
+	generateTagFromStat(statResult, tagBuffer);
+	tag = tagBuffer;
+
+	if (findVariants) {
+		gzipVariant = openVariant(filename + ".gz");
+		brotliVariant = openVariant(filename + ".br");
+	}
+}
+
+//A variant older than the file was made from an earlier version of it; it's not used.
+std::shared_ptr<const OpenFile> OpenFile::openVariant(const std::string& variantPath) const {
+	std::shared_ptr<const OpenFile> variant;
+	try {
+		variant = std::make_shared<const OpenFile>(variantPath);
+	}
+	catch (notFoundError&) {
+		return nullptr;
+	}
+	if (variant->getModifiedTime() < modifiedTime) {
+		return nullptr;
+	}
+	return variant;
+}
+
+//False if the path now names another file, or the file (or one of its variants) changed since it was opened.
+bool OpenFile::isCurrent() const {
+	struct stat statResult;
+	if (stat(path.c_str(), &statResult) != 0) {
+		return false;
+	}
+	if (statResult.st_ino != inode || statResult.st_size != size || statResult.st_mtime != modifiedTime) {
+		return false;
+	}
+	if (!findsVariants) {
+		return true;
+	}
+	return variantIsCurrent(gzipVariant, path + ".gz") && variantIsCurrent(brotliVariant, path + ".br");
+}
+
+//A variant we don't have counts too, once it's there and new enough to be used (e.g. written by precompression).
+bool OpenFile::variantIsCurrent(const std::shared_ptr<const OpenFile>& variant, const std::string& variantPath) const {
+	if (variant) {
+		return variant->isCurrent();
+	}
+
+	struct stat statResult;
+	return stat(variantPath.c_str(), &statResult) != 0 || statResult.st_mtime < modifiedTime;
+}
+
+OpenFile::~OpenFile() {
+	close(fd);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <ctime>
+#include <sys/types.h>
+
+
+//A file opened for sending as it is (closed with the last reference).
+class OpenFile
+{
+	std::string path;
+	int fd;
+	ino_t inode;
+	off_t size;
+	std::time_t modifiedTime;
+	std::string tag;
+	bool findsVariants;
+
+	//Precompressed copies next to the file (name.gz, name.br), if they are at least as new as it.
+	std::shared_ptr<const OpenFile> gzipVariant;
+	std::shared_ptr<const OpenFile> brotliVariant;
+
+	std::shared_ptr<const OpenFile> openVariant(const std::string& variantPath) const;
+	bool variantIsCurrent(const std::shared_ptr<const OpenFile>& variant, const std::string& variantPath) const;
+
+public:
+	explicit OpenFile(const std::string& filename, bool findVariants = false);
+	~OpenFile();
+
+	OpenFile(const OpenFile&) = delete;
+	OpenFile& operator=(const OpenFile&) = delete;
+
+	const std::string& getPath() const {
+		return path;
+	}
+
+	bool isCurrent() const;
+
+	int getFd() const {
+		return fd;
+	}
+
+	off_t getSize() const {
+		return size;
+	}
+
+	std::time_t getModifiedTime() const {
+		return modifiedTime;
+	}
+
+	//Same as the ETag of a cached file.
+	const std::string& getTag() const {
+		return tag;
+	}
+
+	const std::shared_ptr<const OpenFile>& getGzipVariant() const {
+		return gzipVariant;
+	}
+
+	const std::shared_ptr<const OpenFile>& getBrotliVariant() const {
+		return brotliVariant;
+	}
+
+	bool hasVariants() const {
+		return gzipVariant || brotliVariant;
+	}
+};
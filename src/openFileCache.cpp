@@ -0,0 +1,57 @@
+#include "openFileCache.h"
+
+#define DBG_DISABLE
+#include "dbg.h"
+
+
+OpenFileCache::OpenFileCache(size_t maxEntries, int validSec)
+	: maxEntries(maxEntries), validSec(validSec) {
+}
+
+
+//Returns false if the target isn't cached, or its file changed; *file is NULL for targets that aren't static files.
+bool OpenFileCache::get(const std::string& target, std::shared_ptr<const OpenFile>* file) {
+	auto it = cacheMap.find(target);
+	if (it == cacheMap.end()) {
+		return false;
+	}
+
+	CacheEntry& entry = it->second;
+	std::time_t now = std::time(NULL);
+	if (now - entry.checkedTime >= validSec) {
+		if (!entry.file || !entry.file->isCurrent()) {
+			DBG_FMT("Open file cache: %1% changed", target);
+			erase(it);
+			return false;
+		}
+		entry.checkedTime = now;
+	}
+
+	useOrder.splice(useOrder.begin(), useOrder, entry.useIt);
+	*file = entry.file;
+	return true;
+}
+
+void OpenFileCache::put(const std::string& target, std::shared_ptr<const OpenFile> file) {
+	if (maxEntries == 0) {
+		return;
+	}
+
+	auto it = cacheMap.find(target);
+	if (it != cacheMap.end()) {
+		erase(it);
+	}
+
+	while (cacheMap.size() >= maxEntries) {
+		erase(cacheMap.find(useOrder.back()));
+	}
+
+	useOrder.push_front(target);
+	cacheMap[target] = CacheEntry{std::move(file), std::time(NULL), useOrder.begin()};
+}
+
+//Responses still being sent keep their file open; it's closed with the last of them.
+void OpenFileCache::erase(std::unordered_map<std::string, CacheEntry>::iterator it) {
+	useOrder.erase(it->second.useIt);
+	cacheMap.erase(it);
+}
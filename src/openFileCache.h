@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <ctime>
+#include "openFile.h"
+
+
+/*
+	Keeps static files open, by the target they were requested as, so hot files are served without
+	touching the filesystem. Entries are trusted for validSec seconds, then checked with a stat();
+	the least recently used ones are closed once there are more than maxEntries.
+	Targets that aren't static files are remembered too (with no file), and looked up again after validSec.
+*/
+class OpenFileCache
+{
+	struct CacheEntry
+	{
+		std::shared_ptr<const OpenFile> file;
+		std::time_t checkedTime;
+		std::list<std::string>::iterator useIt;
+	};
+
+	size_t maxEntries;
+	int validSec;
+
+	std::unordered_map<std::string, CacheEntry> cacheMap;
+	//Most recently used first.
+	std::list<std::string> useOrder;
+
+	void erase(std::unordered_map<std::string, CacheEntry>::iterator it);
+
+public:
+	OpenFileCache(size_t maxEntries, int validSec);
+
+	bool get(const std::string& target, std::shared_ptr<const OpenFile>* file);
+	void put(const std::string& target, std::shared_ptr<const OpenFile> file);
+};
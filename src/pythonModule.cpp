@@ -4,6 +4,7 @@
 #include<boost/format.hpp>
 #include<string>
 #include<cstdlib>
+#include<unistd.h>
 #include"path.h"
 #include"except.h"
 
@@ -19,6 +20,7 @@ PythonModule PythonModule::krait("krait");
 PythonModule PythonModule::mvc("krait.mvc");
 PythonModule PythonModule::websockets("krait.websockets");
 PythonModule PythonModule::config("krait.config");
+PythonModule PythonModule::cookie("krait.cookie");
 
 
 bool PythonModule::pythonInitialized = false;
@@ -119,6 +121,8 @@ PythonModule::PythonModule(std::string name) {
 	DBG_FMT("PythonModule(%1%)", name);
 	initPython();
 
+	stateSaved = false;
+
 	try {
 		this->name = name;
 		moduleObject = import(bp::str(name));
@@ -137,6 +141,90 @@ void PythonModule::clear() {
 }
 
 
+//Containers are copied, as requests usually change them in place (e.g. krait.mvc.ctrl_stack).
+static bool isMutableContainer(const bp::object& value) {
+	PyObject* valuePtr = value.ptr();
+	return PyList_Check(valuePtr) || PyDict_Check(valuePtr) || PyAnySet_Check(valuePtr);
+}
+
+void PythonModule::saveState() {
+	DBG_FMT("saveState(%1%)", name);
+	try {
+		bp::object copyFunc = bp::import("copy").attr("copy");
+		bp::list items = moduleGlobals.items();
+		long nrItems = bp::len(items);
+
+		savedGlobals = bp::dict();
+		for (long i = 0; i < nrItems; i++) {
+			bp::object key = items[i][0];
+			bp::object value = items[i][1];
+			savedGlobals[key] = isMutableContainer(value) ? copyFunc(value) : value;
+		}
+	}
+	catch (bp::error_already_set const&) {
+		DBG("Python error in saveState()!");
+
+		BOOST_THROW_EXCEPTION(pythonError() << getPyErrorInfo() << originCallInfo(formatString("saveState(%1%)", name)));
+	}
+
+	stateSaved = true;
+}
+
+void PythonModule::restoreState() {
+	if (!stateSaved) {
+		BOOST_THROW_EXCEPTION(serverError() << stringInfoFromFormat("Tried to restore state of module %1% without saving it first.", name));
+	}
+
+	DBG_FMT("restoreState(%1%)", name);
+	try {
+		bp::object copyFunc = bp::import("copy").attr("copy");
+
+		bp::list currentKeys = moduleGlobals.keys();
+		long nrCurrentKeys = bp::len(currentKeys);
+		for (long i = 0; i < nrCurrentKeys; i++) {
+			bp::object key = currentKeys[i];
+			if (!savedGlobals.has_key(key)) {
+				bp::api::delitem(moduleGlobals, key);
+			}
+		}
+
+		bp::list items = savedGlobals.items();
+		long nrItems = bp::len(items);
+		for (long i = 0; i < nrItems; i++) {
+			bp::object key = items[i][0];
+			bp::object value = items[i][1];
+			if (isMutableContainer(value)) {
+				moduleGlobals[key] = copyFunc(value);
+			}
+			else if (!moduleGlobals.has_key(key) || bp::object(moduleGlobals[key]).ptr() != value.ptr()) {
+				moduleGlobals[key] = value;
+			}
+		}
+	}
+	catch (bp::error_already_set const&) {
+		DBG("Python error in restoreState()!");
+
+		BOOST_THROW_EXCEPTION(pythonError() << getPyErrorInfo() << originCallInfo(formatString("restoreState(%1%)", name)));
+	}
+}
+
+void PythonModule::saveRequestState() {
+	PythonModule::main.saveState();
+	PythonModule::krait.saveState();
+	PythonModule::mvc.saveState();
+	PythonModule::websockets.saveState();
+	PythonModule::cookie.saveState();
+}
+
+void PythonModule::restoreRequestState() {
+	PythonModule::main.restoreState();
+	PythonModule::krait.restoreState();
+	PythonModule::mvc.restoreState();
+	PythonModule::websockets.restoreState();
+	PythonModule::cookie.restoreState();
+}
+
+
 void PythonModule::run(std::string command) {
 	DBG("in run()");
 	try {
@@ -487,13 +575,46 @@ PyObject* PythonModule::StringMultimapToPythonObjectConverter::convert(
 PyObject* PythonModule::requestToPythonObjectConverter::convert(Request const& request) {
 	DBG("in Request->PyObject()");
 
+	//Python wants a dict; repeated headers are joined like Request::getHeader() does.
+	bp::dict headers;
+	for (const HeaderField& header : request.getHeaders()) {
+		bp::str name(header.name.data(), header.name.size());
+		bp::str value(header.value.data(), header.value.size());
+		if (headers.has_key(name)) {
+			headers[name] = headers[name] + (header.name == "cookie" ? "; " : ",") + value;
+		}
+		else {
+			headers[name] = value;
+		}
+	}
+
+	//A large body stays in its file; Python gets its own handle to it.
+	bp::object body;
+	bp::object bodyFile;
+	if (request.getBodyFile() != nullptr) {
+		int fd = dup(request.getBodyFile()->getFd());
+		FILE* file = fd == -1 ? NULL : fdopen(fd, "rb");
+		if (file == NULL) {
+			if (fd != -1) {
+				close(fd);
+			}
+			BOOST_THROW_EXCEPTION(syscallError() << stringInfo("dup()/fdopen(): opening request body file") << errcodeInfoDef());
+		}
+		rewind(file);
+		bodyFile = bp::object(bp::handle<>(PyFile_FromFile(file, (char*)"<request body>", (char*)"rb", fclose)));
+	}
+	else {
+		body = bp::str(request.getBody().data(), request.getBody().size());
+	}
+
 	bp::object result = PythonModule::requestType(
 		bp::str(httpVerbToString(request.getVerb())),
-		bp::str(request.getUrl()),
-		bp::str(request.getQueryString()),
+		bp::str(request.getUrl().data(), request.getUrl().size()),
+		bp::str(request.getQueryString().data(), request.getQueryString().size()),
 		bp::str((b::format("HTTP/%1%.%2%") % request.getHttpMajor() % request.getHttpMinor()).str()),
-		bp::dict(request.getHeaders()),
-		bp::str(request.getBody())
+		headers,
+		body,
+		bodyFile
 	);
 
 	return bp::incref(result.ptr());
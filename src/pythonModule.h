@@ -15,6 +15,9 @@ private:
 	boost::python::object moduleObject;
 	boost::python::dict moduleGlobals;
 
+	boost::python::dict savedGlobals;
+	bool stateSaved;
+
 	//Statics
 public:
 	static PythonModule main;
@@ -22,6 +25,7 @@ public:
 	static PythonModule mvc;
 	static PythonModule websockets;
 	static PythonModule config;
+	static PythonModule cookie;
 
 private:
 	static bool pythonInitialized;
@@ -33,6 +37,9 @@ public:
 	explicit PythonModule(std::string name);
 	void clear();
 
+	void saveState();
+	void restoreState();
+
 	void run(std::string command);
 	void execfile(std::string filename);
 	std::string eval(std::string code);
@@ -87,6 +94,9 @@ public:
 	static void initPython();
 	static void initModules(std::string projectDir);
 	static void finishPython();
+
+	static void saveRequestState();
+	static void restoreRequestState();
 private:
 	static void resetModules(std::string projectDir);
 
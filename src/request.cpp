@@ -1,4 +1,7 @@
 #include<string>
+#include<string.h>
+#include<climits>
+#include<unistd.h>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/lexical_cast.hpp>
@@ -12,51 +15,75 @@ namespace b = boost;
 namespace ba = boost::algorithm;
 
 
-Request::Request(HttpVerb verb, const std::string& url, const std::string& queryString, int httpMajor, int httpMinor,
-                 const std::map<std::string, std::string>& headers, const std::string& body) {
+Request::Request(HttpVerb verb, std::shared_ptr<const std::string> buffer, boost::string_view url, boost::string_view queryString,
+                 int httpMajor, int httpMinor, std::vector<HeaderField>&& headers, boost::string_view body,
+                 std::shared_ptr<const RequestBodyFile> bodyFile)
+	: buffer(std::move(buffer)), headers(std::move(headers)), bodyFile(std::move(bodyFile)) {
 	this->verb = verb;
 	this->url = url;
 	this->httpMajor = httpMajor;
 	this->httpMinor = httpMinor;
-	this->headers = std::map<std::string, std::string>();
-	for (auto p : headers) {
-		this->headers[ba::to_lower_copy(p.first)] = p.second;
-	}
-
-	this->body = std::string(body);
+	this->body = body;
 	this->queryString = queryString;
 
 	this->routeVerb = toRouteVerb(verb);
 }
 
-bool Request::headerExists(std::string name) {
-	const auto iterFound = headers.find(ba::to_lower_copy(name));
-	return (iterFound != headers.end());
+RequestBodyFile::RequestBodyFile(int fd)
+	: fd(fd) {
+}
+
+RequestBodyFile::~RequestBodyFile() {
+	close(fd);
+}
+
+
+//Returns the first value of the header; a linear scan beats a map for the dozen headers a request has.
+boost::optional<boost::string_view> Request::findHeader(boost::string_view name) const {
+	for (const HeaderField& header : headers) {
+		if (header.name.size() == name.size() && ba::iequals(header.name, name)) {
+			return header.value;
+		}
+	}
+	return boost::none;
 }
 
+bool Request::headerExists(const std::string& name) const {
+	return findHeader(name) != boost::none;
+}
+
+//Repeated headers are joined with commas; cookies with "; ", the only separator their syntax allows.
 const boost::optional<std::string> Request::getHeader(const std::string& name) const {
-	const auto iterFound = headers.find(ba::to_lower_copy(name));
-	if (iterFound == headers.end()) {
-		return boost::none;
+	const char* separator = ba::iequals(name, "cookie") ? "; " : ",";
+	boost::optional<std::string> result;
+	for (const HeaderField& header : headers) {
+		if (header.name.size() == name.size() && ba::iequals(header.name, name)) {
+			if (result) {
+				result->append(separator).append(header.value.data(), header.value.size());
+			}
+			else {
+				result = header.value.to_string();
+			}
+		}
 	}
-	return iterFound->second;
+	return result;
 }
 
 
 bool Request::isKeepAlive() const {
-	auto it = headers.find("connection");
+	boost::optional<boost::string_view> connection = findHeader("connection");
 
 	if (httpMajor < 1 || (httpMajor == 1 && httpMinor < 1)) {
-		if (it == headers.end()) {
+		if (!connection) {
 			return false;
 		}
-		return ba::to_lower_copy(it->second) == "keep-alive";
+		return ba::iequals(*connection, "keep-alive");
 	}
 	else {
-		if (it == headers.end()) {
+		if (!connection) {
 			return true;
 		}
-		return ba::to_lower_copy(it->second) != "close";
+		return !ba::iequals(*connection, "close");
 	}
 }
 
@@ -64,19 +91,19 @@ int Request::getKeepAliveTimeout() const {
 	if (!this->isKeepAlive()) {
 		return 0;
 	}
-	auto it = headers.find("keep-alive");
-	if (it == headers.end()) {
+	boost::optional<boost::string_view> keepAlive = findHeader("keep-alive");
+	if (!keepAlive) {
 		return INT_MAX; //will be set with a minimum.
 	}
 
-	std::string value = it->second;
-	if (!boost::starts_with(value, "timeout=")) {
+	boost::string_view value = *keepAlive;
+	if (!value.starts_with("timeout=")) {
 		return 0; //other unsupported timeout types, ignore.
 	}
 
-	std::string secondsStr = value.substr(std::string("timeout=").length());
+	boost::string_view secondsStr = value.substr(strlen("timeout="));
 	try {
-		return boost::lexical_cast<int>(secondsStr);
+		return boost::lexical_cast<int>(secondsStr.data(), secondsStr.size());
 	}
 	catch (const b::bad_lexical_cast&) {
 		Loggers::logErr("Received non-integer as timeout seconds\n");
@@ -85,16 +112,16 @@ int Request::getKeepAliveTimeout() const {
 }
 
 bool Request::isUpgrade() {
-	return getHeader("upgrade") != boost::none;
+	return findHeader("upgrade") != boost::none;
 }
 
 
 bool Request::isUpgrade(std::string protocol) {
-	boost::optional<std::string> upgradeHeaderOpt = getHeader("upgrade");
+	boost::optional<boost::string_view> upgradeHeaderOpt = findHeader("upgrade");
 	if (upgradeHeaderOpt == boost::none) {
 		return false;
 	}
-	std::string& upgradeHeader = upgradeHeaderOpt.get();
+	boost::string_view upgradeHeader = upgradeHeaderOpt.get();
 	size_t valueStart = 0;
 	size_t commaIdx = upgradeHeader.find(',', 0);
 	while (commaIdx != std::string::npos) {
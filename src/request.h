@@ -1,34 +1,71 @@
 #pragma once
 #include<string>
-#include<map>
+#include<vector>
+#include<memory>
 #include <boost/optional.hpp>
+#include <boost/utility/string_view.hpp>
 #include"http.h"
 
 
+struct HeaderField
+{
+	boost::string_view name; //Lowercase.
+	boost::string_view value;
+};
+
+
+//A request body too large to keep in memory, in an unlinked temporary file (closed with the last reference).
+class RequestBodyFile
+{
+	int fd;
+
+public:
+	explicit RequestBodyFile(int fd);
+	~RequestBodyFile();
+
+	RequestBodyFile(const RequestBodyFile&) = delete;
+	RequestBodyFile& operator=(const RequestBodyFile&) = delete;
+
+	int getFd() const {
+		return fd;
+	}
+};
+
+
+/*
+	A request as received: all the text fields are views into a single buffer (the raw request),
+	shared by all copies of the Request and kept alive as long as any of them.
+*/
 class Request
 {
 private:
+	std::shared_ptr<const std::string> buffer;
+
 	HttpVerb verb;
 	RouteVerb routeVerb;
-	std::string url;
+	boost::string_view url;
 	int httpMajor;
 	int httpMinor;
-	std::map<std::string, std::string> headers;
-	std::string body;
-	std::string queryString;
+	std::vector<HeaderField> headers;
+	boost::string_view body;
+	boost::string_view queryString;
+	std::shared_ptr<const RequestBodyFile> bodyFile;
+
+	boost::optional<boost::string_view> findHeader(boost::string_view name) const;
 
 public:
-	Request(HttpVerb verb, const std::string& url, const std::string& queryString, int httpMajor, int httpMinor,
-	        const std::map<std::string, std::string>& headers, const std::string& body);
+	Request(HttpVerb verb, std::shared_ptr<const std::string> buffer, boost::string_view url, boost::string_view queryString,
+	        int httpMajor, int httpMinor, std::vector<HeaderField>&& headers, boost::string_view body,
+	        std::shared_ptr<const RequestBodyFile> bodyFile = nullptr);
 
-	bool headerExists(std::string name);
+	bool headerExists(const std::string& name) const;
 	const boost::optional<std::string> getHeader(const std::string& name) const;
 
 	const HttpVerb getVerb() const {
 		return verb;
 	};
 
-	const std::string& getUrl() const {
+	boost::string_view getUrl() const {
 		return url;
 	}
 
@@ -40,15 +77,21 @@ public:
 		return httpMinor;
 	}
 
-	const std::map<std::string, std::string>& getHeaders() const {
+	//Repeated headers appear once for each time they were sent.
+	const std::vector<HeaderField>& getHeaders() const {
 		return headers;
 	}
 
-	const std::string& getBody() const {
+	//Empty if the body is in a file.
+	boost::string_view getBody() const {
 		return body;
 	}
 
-	const std::string getQueryString() const {
+	const RequestBodyFile* getBodyFile() const {
+		return bodyFile.get();
+	}
+
+	boost::string_view getQueryString() const {
 		return queryString;
 	}
 
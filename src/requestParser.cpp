@@ -1,187 +1,434 @@
+#include <string.h>
+#include <ctype.h>
+#include <climits>
+#include <algorithm>
+#include <iterator>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <boost/algorithm/string/predicate.hpp>
-#include <boost/algorithm/string/case_conv.hpp>
 
 #include "requestParser.h"
-#include "fsm.h"
+#include "except.h"
 
 #define DBG_DISABLE
 #include "dbg.h"
 
-namespace b = boost;
 namespace ba = boost::algorithm;
 
+static int createSpillFile();
 
-RequestParser::RequestParser() {
-	state = 0;
+
+RequestParser::RequestParser(size_t bodySpillThreshold, unsigned long long maxBodySize)
+	: bodySpillThreshold(bodySpillThreshold), maxBodySize(maxBodySize) {
+	headLength = 0;
+	headFinished = false;
 	finished = false;
-	memzero(workingStr);
-	workingIdx = 0;
+	bodyLength = 0;
 	bodyLeft = 0;
+	chunked = false;
+	chunkState = ChunkState::Size;
+	trailerOffset = 0;
+	chunkedLength = 0;
 }
 
 
-bool RequestParser::consumeOne(char chr) {
-	if (chr == '\0') {
-		BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Got null character!"));
-	}
+//Stops at the end of the request; returns how many bytes were used, the rest belongs to the next request.
+int RequestParser::consume(char* data, int dataLen) {
+	int used = 0;
 
-	FsmStart(int, state, char, chr, workingStr, sizeof(workingStr), workingIdx, workingBackBuffer, NULL, NULL)
-			StatesBegin(0) { //Before any; skipping spaces before HTTP method
-			SaveStart()
-			TransIf(' ', stCurrent, true)
-			TransElse(1, true)
-		}
-			StatesNext(1) { //Reading HTTP Method
-			TransIf(' ', 2, true)
-			TransElse(stCurrent, true)
-			SaveThisIfSame()
-		}
-			StatesNext(2) { //Finished reading HTTP method; skipping spaces before URL
-			SaveStoreOne(methodString)
-			SaveStart()
-			TransIf(' ', stCurrent, true)
-			TransElse(3, true)
-		}
-			StatesNext(3) { //Reading URL
-			TransIf(' ', 4, true)
-			TransElse(stCurrent, true)
-			SaveThisIfSame()
-		}
-			StatesNext(4) { //Finished reading URL; skipping before HTTP version
-			SaveStoreOne(url)
-			SaveStart()
-			TransIf(' ', stCurrent, true)
-			TransElse(5, true)
-		}
-			StatesNext(5) { //Reading HTTP version
-			TransIf('\r', 6, true)
-			TransElse(stCurrent, true)
-			SaveThisIfSame()
-		}
-			StatesNext(6) { //After HTTP version
-			SaveStore(httpVersion)
-			TransIf('\n', 7, true)
-			TransElseError()
-		}
-			StatesNext(7) { //Header start or CRLF; TODO: Some headers start with space!
-			TransIf('\r', 20, true)
-			TransElse(8, false)
-		}
-			StatesNext(8) { //Starting header name
-			SaveStart()
-			TransAlways(9, true)
-		}
-			StatesNext(9) //Consuming header name
-			TransIf(':', 10, true)
-			TransElse(stCurrent, true)
-			SaveThisIfSame()
-			StatesNext(10) { //After header name
-			SaveStore(workingHeaderName)
-			TransIf(' ', 11, true)
-			TransElseError()
-		}
-			StatesNext(11) { //Starting header value
-			SaveStart()
-			TransAlways(12, true)
-		}
-			StatesNext(12) { //Consuming header value
-			TransIf('\r', 13, true)
-			TransElse(stCurrent, true)
-			SaveThisIfSame()
-		}
-			StatesNext(13) { //inside CRLF before a header
-			SaveStore(workingHeaderValue);
-			saveHeader(workingHeaderName, workingHeaderValue);
-			TransIf('\n', 7, true)
-			TransElseError()
-		}
-			StatesNext(20) {//inside CRLF before body / end:
-			TransIf('\n', 21, true)
-			TransElseError()
-
-			bodyLeft = getBodyLength();
-			if (bodyLeft == 0) {
-				finished = true;
+	if (!headFinished) {
+		//Empty lines before the request line are allowed (and some clients send a CRLF after a body).
+		if (buffer.empty()) {
+			while (used < dataLen && (data[used] == '\r' || data[used] == '\n' || data[used] == ' ')) {
+				used++;
 			}
 		}
-			StatesNext(21) { //First character of body
-			if (finished) {
-				BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Request already finished, but received data!"));
+
+		//The end of the head may have been split between reads.
+		size_t searchFrom = buffer.length() >= 3 ? buffer.length() - 3 : 0;
+		buffer.append(data + used, dataLen - used);
+
+		size_t headEnd = buffer.find("\r\n\r\n", searchFrom);
+		if (headEnd == std::string::npos) {
+			//All of it is head so far; no need to wait for the rest to turn it down.
+			if (memchr(data + used, '\0', dataLen - used) != NULL) {
+				BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Got null character!"));
 			}
-			SaveStart()
-			TransAlways(22, true)
+			if (buffer.length() > maxHeadLength) {
+				BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Request head too long!"));
+			}
+			return dataLen;
+		}
 
-			bodyLeft--;
-			if (bodyLeft == 0) {
-				finished = true;
-				SaveStore(body)
-				TransAlways(25, true)
+		headLength = headEnd + 4;
+		used = dataLen - (int)(buffer.length() - headLength);
+		buffer.resize(headLength);
+
+		parseHead();
+		headFinished = true;
+
+		chunked = parseChunked();
+		bodyLength = parseBodyLength();
+		if (chunked && bodyLength != 0) {
+			//A proxy in front of us may have used the other one.
+			BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Both Content-Length and chunked Transfer-Encoding!"));
+		}
+		bodyLeft = bodyLength;
+		if (chunked) {
+			chunkState = ChunkState::Size;
+		}
+		else if (bodySpillThreshold != 0 && bodyLeft > bodySpillThreshold) {
+			bodyFile = std::make_shared<RequestBodyFile>(createSpillFile());
+		}
+		else {
+			//The client could claim any length; only what it sends is stored.
+			if (bodyLeft > buffer.max_size() - headLength) {
+				BOOST_THROW_EXCEPTION(bodyTooLargeError() << stringInfo("Content-Length too large!"));
 			}
+			buffer.reserve(headLength + (size_t)std::min(bodyLeft, (unsigned long long)maxBodyReserve));
 		}
-			StatesNext(22) { //Characters of body
-			SaveThis()
+	}
 
-			bodyLeft--;
+	if (chunked) {
+		return used + (int)consumeChunked(data + used, dataLen - used);
+	}
+
+	size_t bodyBytes = std::min((unsigned long long)(dataLen - used), bodyLeft);
+	storeBody(data + used, bodyBytes);
+	bodyLeft -= bodyBytes;
+	used += (int)bodyBytes;
+
+	if (bodyLeft == 0) {
+		finished = true;
+	}
+	return used;
+}
+
+
+//Decodes as much of a chunked body as there is; chunk sizes, chunk ends and trailers may be split between reads.
+size_t RequestParser::consumeChunked(const char* data, size_t length) {
+	size_t used = 0;
+
+	while (used < length && !finished) {
+		if (chunkState == ChunkState::Data) {
+			size_t dataBytes = std::min((unsigned long long)(length - used), bodyLeft);
+			storeBody(data + used, dataBytes);
+			bodyLeft -= dataBytes;
+			used += dataBytes;
 			if (bodyLeft == 0) {
+				chunkState = ChunkState::DataEnd;
+			}
+			continue;
+		}
+
+		if (chunkState == ChunkState::Trailer) {
+			//Trailers are kept after the body, and parsed like the head once they are all in.
+			size_t searchFrom = buffer.length() > trailerOffset + 3 ? buffer.length() - 3 : trailerOffset;
+			const char* lineEnd = (const char*)memchr(data + used, '\n', length - used);
+			size_t lineBytes = lineEnd == NULL ? length - used : lineEnd + 1 - (data + used);
+			buffer.append(data + used, lineBytes);
+			used += lineBytes;
+
+			if (buffer.compare(trailerOffset, std::string::npos, "\r\n") == 0) {
+				buffer.resize(trailerOffset);
 				finished = true;
-				SaveStore(body)
-				TransAlways(25, true)
 			}
+			else if (buffer.find("\r\n\r\n", searchFrom) != std::string::npos) {
+				if (memchr(buffer.data() + trailerOffset, '\0', buffer.length() - trailerOffset) != NULL) {
+					BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Got null character!"));
+				}
+				parseTrailers();
+				finished = true;
+			}
+			else if (buffer.length() - trailerOffset > maxHeadLength) {
+				BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Chunked trailers too long!"));
+			}
+			continue;
+		}
+
+		//Chunk size lines and the CRLF after each chunk are gathered in chunkLine.
+		const char* lineEnd = (const char*)memchr(data + used, '\n', length - used);
+		size_t lineBytes = lineEnd == NULL ? length - used : lineEnd + 1 - (data + used);
+		chunkLine.append(data + used, lineBytes);
+		used += lineBytes;
+		if (lineEnd == NULL) {
+			if (chunkLine.length() > maxChunkLineLength) {
+				BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Chunk size line too long!"));
+			}
+			continue;
 		}
-			StatesNext(25) {
-			BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Request already finished, but received data!"));
 
+		if (chunkState == ChunkState::DataEnd) {
+			if (chunkLine != "\r\n") {
+				BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Chunk not followed by CRLF!"));
+			}
+			chunkState = ChunkState::Size;
 		}
-			StatesEnd()
-	FsmEnd()
+		else {
+			bodyLeft = parseChunkSize(chunkLine);
+			//Checked as each chunk is announced, before any of it is stored.
+			if (maxBodySize != 0 && bodyLeft > maxBodySize - chunkedLength) {
+				BOOST_THROW_EXCEPTION(bodyTooLargeError() << stringInfo("Chunked body larger than the limit!"));
+			}
+			chunkedLength += bodyLeft;
+			if (bodyLeft != 0) {
+				chunkState = ChunkState::Data;
+			}
+			else {
+				chunkState = ChunkState::Trailer;
+				trailerOffset = buffer.length();
+			}
+		}
+		chunkLine.clear();
+	}
+
+	return used;
 }
 
+//A hex size, maybe followed by extensions (ignored), then CRLF.
+unsigned long long RequestParser::parseChunkSize(const std::string& line) {
+	unsigned long long size = 0;
+	size_t idx = 0;
+	while (idx < line.length() && isxdigit(line[idx])) {
+		if (size > ULLONG_MAX / 16) {
+			BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Chunk size too large!"));
+		}
+		char digit = (char)tolower(line[idx]);
+		size = size * 16 + (isdigit(digit) ? digit - '0' : digit - 'a' + 10);
+		idx++;
+	}
+	if (memchr(line.data(), '\0', line.length()) != NULL) {
+		BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Got null character!"));
+	}
+	if (idx == 0 || line.length() < 2 || line.compare(line.length() - 2, 2, "\r\n") != 0 ||
+		(idx != line.length() - 2 && line[idx] != ';' && line[idx] != ' ' && line[idx] != '\t')) {
+		BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Bad chunk size line!"));
+	}
+	return size;
+}
 
-int RequestParser::getBodyLength() {
-	auto foundHeader = headers.find("content-length");
-	if (foundHeader == headers.end()) {
-		return 0;
+void RequestParser::parseTrailers() {
+	size_t headerCount = headerSpans.size();
+	parseHeaderLines(trailerOffset, buffer.length() - 2);
+
+	//Trailers can't change how the request was framed.
+	headerSpans.erase(std::remove_if(headerSpans.begin() + headerCount, headerSpans.end(),
+		[this](const std::pair<Span, Span>& header) {
+			return buffer.compare(header.first.offset, header.first.length, "content-length") == 0 ||
+				buffer.compare(header.first.offset, header.first.length, "transfer-encoding") == 0;
+		}), headerSpans.end());
+}
+
+
+//Large bodies are written to a file as they arrive, so they never have to fit in memory.
+static int createSpillFile() {
+	const char* tempDir = getenv("TMPDIR");
+	if (tempDir == NULL) {
+		tempDir = "/tmp";
+	}
+
+	int fd = open(tempDir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+	if (fd == -1) {
+		//No O_TMPFILE support; unlink the file right away instead.
+		std::string nameTemplate = std::string(tempDir) + "/krait-body-XXXXXX";
+		fd = mkostemp(&nameTemplate[0], O_CLOEXEC);
+		if (fd != -1) {
+			unlink(nameTemplate.c_str());
+		}
+	}
+	if (fd == -1) {
+		BOOST_THROW_EXCEPTION(syscallError() << stringInfoFromFormat("open(): creating request body file in %1%", tempDir) <<
+			errcodeInfoDef());
+	}
+	return fd;
+}
+
+//Chunked bodies have no length up front; they move to a file once they grow past the threshold.
+void RequestParser::storeBody(const char* data, size_t length) {
+	if (!bodyFile && bodySpillThreshold != 0 && buffer.length() - headLength + length > bodySpillThreshold) {
+		bodyFile = std::make_shared<RequestBodyFile>(createSpillFile());
+		spillBody(buffer.data() + headLength, buffer.length() - headLength);
+		buffer.resize(headLength);
+	}
+
+	if (bodyFile) {
+		spillBody(data, length);
 	}
 	else {
-		size_t idx = 0;
-		int length = stoi(foundHeader->second, &idx, 10);
+		buffer.append(data, length);
+	}
+}
 
-		if (idx != foundHeader->second.size()) {
-			BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Content-Length not int!"));
+void RequestParser::spillBody(const char* data, size_t length) {
+	while (length != 0) {
+		ssize_t written = write(bodyFile->getFd(), data, length);
+		if (written == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			BOOST_THROW_EXCEPTION(syscallError() << stringInfo("write(): saving request body to file") << errcodeInfoDef());
 		}
+		data += written;
+		length -= written;
+	}
+}
 
-		return length;
+
+static const char* skipSpaces(const char* pos, const char* end) {
+	while (pos != end && *pos == ' ') {
+		pos++;
 	}
+	return pos;
 }
 
-void RequestParser::saveHeader(std::string name, std::string value) {
-	ba::to_lower(name);
-	auto foundName = headers.find(name);
-	if (foundName == headers.end()) {
-		headers.insert(make_pair(name, value));
+//Parses the request line and headers in one pass, jumping between delimiters.
+//Only positions are recorded; the strings are cut out of the buffer when the request is done.
+void RequestParser::parseHead() {
+	const char* base = buffer.data();
+	const char* pos = base;
+	//The head ends with an empty line; stop right before it.
+	const char* end = base + headLength - 2;
+
+	//NULs would cut the strings short for anything that reads them as C strings.
+	if (memchr(pos, '\0', headLength) != NULL) {
+		BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Got null character!"));
 	}
-	else {
-		headers[name] = headers[name] + "," + value;
+
+	const char* lineEnd = (const char*)memchr(pos, '\r', end - pos);
+	if (lineEnd == NULL || lineEnd[1] != '\n') {
+		BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Bad request line!"));
 	}
+
+	const char* methodEnd = (const char*)memchr(pos, ' ', lineEnd - pos);
+	if (methodEnd == NULL) {
+		BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Bad request line: no URL!"));
+	}
+	methodSpan = Span{0, (size_t)(methodEnd - base)};
+
+	const char* urlStart = skipSpaces(methodEnd, lineEnd);
+	const char* urlEnd = (const char*)memchr(urlStart, ' ', lineEnd - urlStart);
+	if (urlEnd == NULL || urlEnd == urlStart) {
+		BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Bad request line: no HTTP version!"));
+	}
+	urlSpan = Span{(size_t)(urlStart - base), (size_t)(urlEnd - urlStart)};
+
+	const char* versionStart = skipSpaces(urlEnd, lineEnd);
+	versionSpan = Span{(size_t)(versionStart - base), (size_t)(lineEnd - versionStart)};
+
+	parseHeaderLines(lineEnd + 2 - base, end - base);
 }
 
+//Header lines (headers or chunked trailers) between from and to, each ending with a CRLF.
+void RequestParser::parseHeaderLines(size_t from, size_t to) {
+	const char* base = buffer.data();
+	const char* pos = base + from;
+	const char* end = base + to;
+	const char* lineEnd;
+
+	while (pos < end) {
+		lineEnd = (const char*)memchr(pos, '\r', end - pos);
+		if (lineEnd == NULL || lineEnd[1] != '\n') {
+			BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Bad header line!"));
+		}
+
+		const char* colon = (const char*)memchr(pos, ':', lineEnd - pos);
+		if (colon == NULL || colon == pos) {
+			BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Header without a name!"));
+		}
 
-void RequestParser::consume(char* data, int dataLen) {
-	//DBG_FMT("Consuming string of length %1% (real len %2%)", dataLen, strlen(data));
-	for (int i = 0; i < dataLen; i++) {
-		//DBG_FMT("i = %1%; chr = %2%", i, int(data[i]));
-		bool consume = consumeOne(data[i]);
-		if (!consume) {
-			i--;
+		const char* valueStart = colon + 1;
+		while (valueStart != lineEnd && (*valueStart == ' ' || *valueStart == '\t')) {
+			valueStart++;
 		}
+		const char* valueEnd = lineEnd;
+		while (valueEnd != valueStart && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t')) {
+			valueEnd--;
+		}
+
+		//Header names are case-insensitive; store them lowercase, in place.
+		for (size_t idx = pos - base; idx < (size_t)(colon - base); idx++) {
+			buffer[idx] = (char)tolower(buffer[idx]);
+		}
+
+		headerSpans.push_back(std::make_pair(Span{(size_t)(pos - base), (size_t)(colon - pos)},
+		                                     Span{(size_t)(valueStart - base), (size_t)(valueEnd - valueStart)}));
+		pos = lineEnd + 2;
 	}
 }
 
 
-bool parseHttpVersion(std::string httpVersion, int* httpMajor, int* httpMinor);
+unsigned long long RequestParser::parseBodyLength() {
+	const Span* lengthSpan = NULL;
+	for (const auto& header : headerSpans) {
+		if (buffer.compare(header.first.offset, header.first.length, "content-length") == 0) {
+			//Two lengths could be read differently by a proxy in front of us; don't guess.
+			if (lengthSpan != NULL) {
+				BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Multiple Content-Length headers!"));
+			}
+			lengthSpan = &header.second;
+		}
+	}
+	if (lengthSpan == NULL) {
+		return 0;
+	}
+
+	unsigned long long length = 0;
+	for (size_t idx = lengthSpan->offset; idx < lengthSpan->offset + lengthSpan->length; idx++) {
+		if (!isdigit(buffer[idx]) || length > ULLONG_MAX / 10 - 1) {
+			BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Content-Length not int!"));
+		}
+		length = length * 10 + (buffer[idx] - '0');
+	}
+	if (lengthSpan->length == 0) {
+		BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("Content-Length not int!"));
+	}
+
+	return length;
+}
+
+
+//Only plain "chunked" is supported; other codings would have to be undone before the app sees the body.
+bool RequestParser::parseChunked() {
+	bool result = false;
+	for (const auto& header : headerSpans) {
+		if (buffer.compare(header.first.offset, header.first.length, "transfer-encoding") == 0) {
+			boost::string_view value(buffer.data() + header.second.offset, header.second.length);
+			if (result || !ba::iequals(value, "chunked")) {
+				BOOST_THROW_EXCEPTION(httpParseError() << stringInfoFromFormat("Transfer-Encoding %1% not supported.", value));
+			}
+			result = true;
+		}
+	}
+	return result;
+}
+
+
+static bool parseHttpVersion(boost::string_view httpVersion, int* httpMajor, int* httpMinor) {
+	//Exactly HTTP/x.y, with single digits.
+	if (httpVersion.size() != strlen("HTTP/1.1") || !httpVersion.starts_with("HTTP/") ||
+		!isdigit(httpVersion[5]) || httpVersion[6] != '.' || !isdigit(httpVersion[7])) {
+		return false;
+	}
+
+	*httpMajor = httpVersion[5] - '0';
+	*httpMinor = httpVersion[7] - '0';
+	return true;
+}
+
+Request RequestParser::getRequestHead() {
+	//Borrows the buffer instead of taking it over; the body in it may be incomplete.
+	return buildRequest(std::shared_ptr<const std::string>(&buffer, [](const std::string*) {}));
+}
 
 Request RequestParser::getRequest() {
-	std::map<std::string, HttpVerb> stringVerbMapping = {
+	//The request takes the buffer over; everything below points into it.
+	return buildRequest(std::make_shared<const std::string>(std::move(buffer)));
+}
+
+Request RequestParser::buildRequest(std::shared_ptr<const std::string> requestBuffer) {
+	static const std::pair<boost::string_view, HttpVerb> stringVerbMapping[] = {
 		{"GET", HttpVerb::GET},
 		{"HEAD", HttpVerb::HEAD},
 		{"POST", HttpVerb::POST},
@@ -192,56 +439,44 @@ Request RequestParser::getRequest() {
 		{"TRACE", HttpVerb::TRACE}
 	};
 
-	auto verbIt = stringVerbMapping.find(methodString);
-	if (verbIt == stringVerbMapping.end()) {
-		BOOST_THROW_EXCEPTION(httpParseError() << stringInfoFromFormat("HTTP method %1% not recognized.", methodString));
+	const char* base = requestBuffer->data();
+	auto view = [base](Span span) {
+		return boost::string_view(base + span.offset, span.length);
+	};
+
+	boost::string_view method = view(methodSpan);
+	const std::pair<boost::string_view, HttpVerb>* verbIt = std::find_if(
+		std::begin(stringVerbMapping), std::end(stringVerbMapping),
+		[method](const std::pair<boost::string_view, HttpVerb>& mapping) { return mapping.first == method; });
+	if (verbIt == std::end(stringVerbMapping)) {
+		BOOST_THROW_EXCEPTION(httpParseError() << stringInfoFromFormat("HTTP method %1% not recognized.", method));
 	}
 	HttpVerb verb = verbIt->second;
 
 	int httpMinor = 1;
 	int httpMajor = 1;
 
-	if (!parseHttpVersion(httpVersion, &httpMajor, &httpMinor)) {
+	if (!parseHttpVersion(view(versionSpan), &httpMajor, &httpMinor)) {
 		BOOST_THROW_EXCEPTION(httpParseError() << stringInfo("HTTP version not recognized."));
 	}
 
-	std::string queryString;
+	boost::string_view url = view(urlSpan);
+	boost::string_view queryString;
 	size_t queryStringStart = url.find('?');
-	if (queryStringStart != std::string::npos) {
+	if (queryStringStart != boost::string_view::npos) {
 		queryString = url.substr(queryStringStart + 1);
-		url.erase(queryStringStart);
-	}
-
-	return Request(verb, url, queryString, httpMajor, httpMinor, headers, body);
-}
-
-bool parseHttpVersion(std::string httpVersion, int* httpMajor, int* httpMinor) {
-	//DBG_FMT("Version: %1%", httpVersion);
-	if (!boost::starts_with(httpVersion, "HTTP/")) {
-		//DBG_FMT("Version fail: %1% doesn't start with 'HTTP/'", httpVersion);
-		return false;
+		url = url.substr(0, queryStringStart);
 	}
 
-	std::string versionPart = httpVersion.substr(strlen("HTTP/"));
-	//DBG_FMT("Version part: %1%", versionPart);
-
-	if (versionPart.size() != 3) {
-		//DBG_FMT("Version fail: %1%'s part %2% doesn't have 3 characters", httpVersion, versionPart);
-		return false;
+	std::vector<HeaderField> headers;
+	headers.reserve(headerSpans.size());
+	for (const auto& header : headerSpans) {
+		headers.push_back(HeaderField{view(header.first), view(header.second)});
 	}
 
-	size_t idx = 0;
-	*httpMajor = std::stoi(versionPart, &idx, 10);
-	if (idx != 1 || versionPart[1] != '.') {
-		//DBG_FMT("Version fail: %1%'s part %2% doesn't start with a single digit or doesn't have the slash", httpVersion,
-		//        versionPart);
-		return false;
-	}
-	*httpMinor = stoi(versionPart.substr(2), &idx, 10);
-	if (idx != 1) {
-		//DBG_FMT("Version fail: %1%'s part %2% doesn't end with a single digit (idx = %3%)", httpVersion, versionPart, idx);
-		return false;
-	}
+	//Chunked trailers, if any, come after the body.
+	size_t bodyEnd = trailerOffset != 0 ? trailerOffset : requestBuffer->size();
+	boost::string_view body(base + headLength, bodyEnd - headLength);
 
-	return true;
+	return Request(verb, requestBuffer, url, queryString, httpMajor, httpMinor, std::move(headers), body, bodyFile);
 }
@@ -1,42 +1,93 @@
 #pragma once
 #include<string>
-#include<map>
+#include<vector>
+#include<utility>
 #include"request.h"
 
 
 class RequestParser
 {
-	int state;
-	std::string workingBackBuffer;
-	char workingStr[65536];
-	unsigned int workingIdx;
+	//A piece of the buffer, by position (the buffer may move while it grows).
+	struct Span
+	{
+		size_t offset;
+		size_t length;
+	};
+
+	enum class ChunkState
+	{
+		Size,
+		Data,
+		DataEnd,
+		Trailer
+	};
+
+	static const size_t maxHeadLength = 65536;
+	static const size_t maxChunkLineLength = 1024;
+	//The most reserved for a body up front; any more grows as it arrives.
+	static const size_t maxBodyReserve = 1048576;
+
+	size_t bodySpillThreshold;
+	unsigned long long maxBodySize;
+	std::shared_ptr<RequestBodyFile> bodyFile;
+
+	std::string buffer;
+	size_t headLength;
+	bool headFinished;
 
 	bool finished;
+	unsigned long long bodyLength;
 	unsigned long long bodyLeft;
 
-	std::string workingHeaderName;
-	std::string workingHeaderValue;
+	bool chunked;
+	ChunkState chunkState;
+	std::string chunkLine;
+	size_t trailerOffset;
+	unsigned long long chunkedLength;
 
-	std::string methodString;
-	std::string url;
-	std::string httpVersion;
-	std::map<std::string, std::string> headers;
-	std::string body;
+	Span methodSpan;
+	Span urlSpan;
+	Span versionSpan;
+	std::vector<std::pair<Span, Span>> headerSpans;
 
-	void saveHeader(std::string name, std::string value);
+	void parseHead();
+	void parseHeaderLines(size_t from, size_t to);
+	void storeBody(const char* data, size_t length);
+	void spillBody(const char* data, size_t length);
 
-	bool consumeOne(char chr);
+	size_t consumeChunked(const char* data, size_t length);
+	static unsigned long long parseChunkSize(const std::string& line);
+	void parseTrailers();
 
-	int getBodyLength();
+	bool parseChunked();
+	unsigned long long parseBodyLength();
+	Request buildRequest(std::shared_ptr<const std::string> requestBuffer);
 
 public:
-	RequestParser();
+	//A chunked body past maxBodySize (if not 0) throws bodyTooLargeError; a Content-Length one is up to the caller,
+	//which sees the length before the body.
+	explicit RequestParser(size_t bodySpillThreshold = 0, unsigned long long maxBodySize = 0);
+
+	int consume(char* data, int dataLen);
 
-	void consume(char* data, int dataLen);
+	bool isHeadFinished() {
+		return headFinished;
+	}
 
 	bool isFinished() {
 		return finished;
 	}
 
+	//Not known up front for chunked bodies; 0 then.
+	unsigned long long getBodyLength() {
+		return bodyLength;
+	}
+
+	bool hasBody() {
+		return bodyLength != 0 || chunked;
+	}
+
+	//The request line and headers, before the body arrives; only valid while the parser is alive and unchanged.
+	Request getRequestHead();
 	Request getRequest();
 };
@@ -0,0 +1,135 @@
+#include <boost/test/unit_test.hpp>
+#include <string>
+
+#include "requestParser.h"
+#include "except.h"
+
+using namespace std;
+
+
+//Feeds the request in pieces of the given size, like reads that split it anywhere.
+static Request parseInPieces(string data, size_t pieceSize, unsigned long long maxBodySize = 0) {
+	RequestParser parser(0, maxBodySize);
+	for (size_t offset = 0; offset < data.length() && !parser.isFinished(); offset += pieceSize) {
+		string piece = data.substr(offset, pieceSize);
+		parser.consume(&piece[0], (int)piece.length());
+	}
+	BOOST_REQUIRE(parser.isFinished());
+	return parser.getRequest();
+}
+
+static const string chunkedHead = "POST /upload HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n";
+
+
+BOOST_AUTO_TEST_SUITE(mod_RequestParser)
+
+BOOST_AUTO_TEST_CASE(func_chunkedSplit) {
+	string request = chunkedHead + "5\r\nhello\r\n1a\r\n, split anywhere you like!\r\n0\r\n\r\n";
+
+	for (size_t pieceSize = 1; pieceSize <= request.length(); pieceSize++) {
+		Request result = parseInPieces(request, pieceSize);
+		BOOST_CHECK_EQUAL(result.getBody(), "hello, split anywhere you like!");
+	}
+}
+
+BOOST_AUTO_TEST_CASE(func_chunkedExtensions) {
+	string request = chunkedHead + "A;name=value\r\n0123456789\r\n3 ; last\r\nabc\r\n0;end\r\n\r\n";
+
+	for (size_t pieceSize = 1; pieceSize <= request.length(); pieceSize++) {
+		Request result = parseInPieces(request, pieceSize);
+		BOOST_CHECK_EQUAL(result.getBody(), "0123456789abc");
+	}
+}
+
+BOOST_AUTO_TEST_CASE(func_chunkedTrailers) {
+	string request = chunkedHead + "4\r\nbody\r\n0\r\nX-Checksum: 1234\r\nContent-Length: 99\r\n\r\n";
+
+	for (size_t pieceSize = 1; pieceSize <= request.length(); pieceSize++) {
+		Request result = parseInPieces(request, pieceSize);
+		BOOST_CHECK_EQUAL(result.getBody(), "body");
+		BOOST_CHECK(result.getHeader("x-checksum") == string("1234"));
+		//Trailers can't change the framing.
+		BOOST_CHECK(!result.getHeader("content-length"));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(func_chunkedPipelined) {
+	string request = chunkedHead + "3\r\nabc\r\n0\r\n\r\n";
+	string next = "GET / HTTP/1.1\r\n\r\n";
+	string data = request + next;
+
+	RequestParser parser;
+	int used = parser.consume(&data[0], (int)data.length());
+	BOOST_REQUIRE(parser.isFinished());
+	BOOST_CHECK_EQUAL(used, (int)request.length());
+	BOOST_CHECK_EQUAL(parser.getRequest().getBody(), "abc");
+}
+
+BOOST_AUTO_TEST_CASE(func_chunkedBadSize) {
+	string request = chunkedHead + "zz\r\nabc\r\n0\r\n\r\n";
+	RequestParser parser;
+	BOOST_CHECK_THROW(parser.consume(&request[0], (int)request.length()), httpParseError);
+}
+
+BOOST_AUTO_TEST_CASE(func_chunkedOverLimit) {
+	//Exactly at the limit is fine.
+	string request = chunkedHead + "4\r\nabcd\r\n4\r\nefgh\r\n0\r\n\r\n";
+	BOOST_CHECK_EQUAL(parseInPieces(request, 7, 8).getBody(), "abcdefgh");
+
+	for (size_t pieceSize = 1; pieceSize <= request.length(); pieceSize++) {
+		BOOST_CHECK_THROW(parseInPieces(request, pieceSize, 7), bodyTooLargeError);
+	}
+
+	//A huge chunk is turned down as it is announced, before any of it arrives.
+	string huge = chunkedHead + "fffffffffff\r\n";
+	RequestParser parser(0, 1024);
+	BOOST_CHECK_THROW(parser.consume(&huge[0], (int)huge.length()), bodyTooLargeError);
+}
+
+BOOST_AUTO_TEST_CASE(func_bothLengths) {
+	string request = "POST / HTTP/1.1\r\nContent-Length: 3\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n";
+	RequestParser parser;
+	BOOST_CHECK_THROW(parser.consume(&request[0], (int)request.length()), httpParseError);
+}
+
+BOOST_AUTO_TEST_CASE(func_hugeContentLength) {
+	//Without limits, a huge length is only stored as it arrives.
+	string request = "POST / HTTP/1.1\r\nContent-Length: 1000000000000000\r\n\r\nabc";
+	RequestParser parser;
+	BOOST_CHECK_EQUAL(parser.consume(&request[0], (int)request.length()), (int)request.length());
+	BOOST_CHECK(parser.isHeadFinished());
+	BOOST_CHECK(!parser.isFinished());
+
+	string unfit = "POST / HTTP/1.1\r\nContent-Length: 18000000000000000000\r\n\r\n";
+	RequestParser unfitParser;
+	BOOST_CHECK_THROW(unfitParser.consume(&unfit[0], (int)unfit.length()), bodyTooLargeError);
+}
+
+BOOST_AUTO_TEST_CASE(func_nullCharacters) {
+	const string nul(1, '\0');
+	const string badRequests[] = {
+		"GET /a" + nul + "b HTTP/1.1\r\nHost: localhost\r\n\r\n",
+		"GET / HTTP/1.1\r\nHost: local" + nul + "host\r\n\r\n",
+		//Turned down before the head is complete.
+		"GET / HTTP/1.1\r\nX-Partial: " + nul,
+		chunkedHead + "3;ext" + nul + "\r\nabc\r\n0\r\n\r\n",
+	};
+	for (const string& request : badRequests) {
+		string data = request;
+		RequestParser parser;
+		BOOST_CHECK_THROW(parser.consume(&data[0], (int)data.length()), httpParseError);
+	}
+
+	//Bodies are the app's business; they may hold anything.
+	string binary = "POST / HTTP/1.1\r\nContent-Length: 3\r\n\r\na" + nul + "b";
+	BOOST_CHECK_EQUAL(parseInPieces(binary, 5).getBody(), "a" + nul + "b");
+}
+
+BOOST_AUTO_TEST_CASE(func_repeatedHeaders) {
+	string request = "GET / HTTP/1.1\r\nAccept: text/html\r\nCookie: a=1\r\nAccept: */*\r\nCookie: b=2\r\n\r\n";
+	Request result = parseInPieces(request, request.length());
+	BOOST_CHECK(result.getHeader("accept") == string("text/html,*/*"));
+	BOOST_CHECK(result.getHeader("Cookie") == string("a=1; b=2"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
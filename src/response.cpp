@@ -13,14 +13,20 @@ namespace b = boost;
 
 
 static std::unordered_map<int, std::string> statusReasons{
+	{100, "Continue"},
 	{101, "Switching Protocols"},
 	{200, "OK"},
+	{206, "Partial Content"},
 	{304, "Not Modified"},
 	{400, "Bad Request"},
 	{401, "Unauthorized"},
 	{403, "Forbidden"},
 	{404, "Not Found"},
-	{500, "Internal Server Error"}
+	{413, "Request Entity Too Large"},
+	{416, "Range Not Satisfiable"},
+	{417, "Expectation Failed"},
+	{500, "Internal Server Error"},
+	{503, "Service Unavailable"}
 };
 
 
@@ -53,7 +59,13 @@ Response::Response(int httpMajor, int httpMinor, int statusCode, std::unordered_
 		this->headers.insert(make_pair(b::to_lower_copy(it.first), it.second));
 	}
 
-	setHeader("Content-Length", std::to_string(bodyIterator.getTotalLength()));
+	//A page still rendering has no length yet; it's sent in chunks as it goes.
+	if (bodyIterator.isComplete()) {
+		setHeader("Content-Length", std::to_string(bodyIterator.getTotalLength()));
+	}
+	else {
+		setHeader("Transfer-Encoding", "chunked");
+	}
 }
 
 Response::Response(int statusCode, std::string body, bool connClose)
@@ -96,6 +108,8 @@ void Response::parseFullResponse(std::string response) {
 
 void Response::setBody(std::string body, bool updateLength) {
 	this->bodyIterator = IteratorResult(body);
+	this->bodyFile.reset();
+	this->bodyCompressor.reset();
 
 	if (updateLength) {
 		setHeader("Content-Length", std::to_string(bodyIterator.getTotalLength()));
@@ -103,6 +117,44 @@ void Response::setBody(std::string body, bool updateLength) {
 }
 
 
+void Response::setBodyEncoding(std::shared_ptr<ICompressionStream> compressor, std::string encoding) {
+	setHeader("Content-Encoding", encoding);
+
+	if (!bodyIterator.isComplete()) {
+		this->bodyCompressor = compressor;
+		this->bodyCompressorFinished = false;
+		return;
+	}
+
+	std::string compressed;
+	const std::string* piece;
+	while ((piece = getBodyNext()) != NULL) {
+		compressed += compressor->compress(*piece, false);
+	}
+	compressed += compressor->finish();
+	setBody(compressed, true);
+}
+
+
+//The body is sent from the file with sendfile(), never read into memory.
+void Response::setBodyFile(std::shared_ptr<const OpenFile> file, off_t offset, size_t length) {
+	setBodyFileParts(std::move(file), std::vector<FilePart>{FilePart{std::string(), offset, length}}, std::string());
+}
+
+void Response::setBodyFileParts(std::shared_ptr<const OpenFile> file, std::vector<FilePart> parts, std::string suffix) {
+	this->bodyIterator = IteratorResult(std::string());
+	this->bodyFile = std::move(file);
+	this->bodyFileParts = std::move(parts);
+	this->bodyFileSuffix = std::move(suffix);
+
+	size_t length = bodyFileSuffix.length();
+	for (const FilePart& part : bodyFileParts) {
+		length += part.prefix.length() + part.length;
+	}
+	setHeader("Content-Length", std::to_string(length));
+}
+
+
 void Response::addHeader(std::string name, std::string value) {
 	boost::to_lower(name);
 	headers.insert(make_pair(name, value));
@@ -183,9 +235,30 @@ std::string Response::getResponseHeaders() {
 }
 
 const std::string* Response::getBodyNext() {
-	const std::string* result = *bodyIterator;
-	++bodyIterator;
-	return result;
+	if (!bodyCompressor) {
+		const std::string* result = *bodyIterator;
+		++bodyIterator;
+		return result;
+	}
+
+	//The compressor holds on to small pieces, so this reads until it has output.
+	while (!bodyCompressorFinished) {
+		const std::string* piece = *bodyIterator;
+		const std::string* result;
+		if (piece == NULL) {
+			bodyCompressorFinished = true;
+			result = &bodyCompressor->finish();
+		}
+		else {
+			//Flushed before the page renders more, so the client sees what's done so far.
+			result = &bodyCompressor->compress(*piece, bodyIterator.isRenderingNext());
+			++bodyIterator;
+		}
+		if (!result->empty()) {
+			return result;
+		}
+	}
+	return NULL;
 }
 
 
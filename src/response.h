@@ -2,8 +2,21 @@
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
+#include <memory>
 #include <boost/optional.hpp>
 #include "iteratorResult.h"
+#include "openFile.h"
+#include "compression.h"
+
+//A range of a file, sent after some text (e.g. the headers of a multipart/byteranges part).
+struct FilePart
+{
+	std::string prefix;
+	off_t offset;
+	size_t length;
+};
+
 
 class Response
 {
@@ -17,11 +30,19 @@ class Response
 	IteratorResult bodyIterator;
 	bool connClose;
 
+	//A body sent straight from a file, instead of bodyIterator.
+	std::shared_ptr<const OpenFile> bodyFile;
+	std::vector<FilePart> bodyFileParts;
+	std::string bodyFileSuffix;
+
+	//Set when a streamed body is compressed as it is sent.
+	std::shared_ptr<ICompressionStream> bodyCompressor;
+	bool bodyCompressorFinished = false;
+
 	std::string statusLine;
 	bool fromFullResponse;
 
 	void parseFullResponse(std::string response);
-	boost::optional<std::string> getHeader(std::string name);
 
 public:
 	Response(int httpMajor, int httpMinor, int statusCode, std::unordered_multimap<std::string, std::string> headers,
@@ -37,7 +58,7 @@ public:
 		this->httpMinor = httpMinor;
 	}
 
-	void getStatusCode(int statusCode) {
+	void setStatusCode(int statusCode) {
 		this->statusCode = statusCode;
 	}
 
@@ -46,6 +67,28 @@ public:
 	}
 
 	void setBody(std::string body, bool updateLength);
+	void setBodyFile(std::shared_ptr<const OpenFile> file, off_t offset, size_t length);
+	void setBodyFileParts(std::shared_ptr<const OpenFile> file, std::vector<FilePart> parts, std::string suffix);
+
+	//Encodes the body with the stream: a complete body right away, a streamed one as it is sent.
+	void setBodyEncoding(std::shared_ptr<ICompressionStream> compressor, std::string encoding);
+
+	//Only known when the body isn't chunked.
+	size_t getBodyLength() {
+		return bodyIterator.getTotalLength();
+	}
+
+	const OpenFile* getBodyFile() const {
+		return bodyFile.get();
+	}
+
+	const std::vector<FilePart>& getBodyFileParts() const {
+		return bodyFileParts;
+	}
+
+	const std::string& getBodyFileSuffix() const {
+		return bodyFileSuffix;
+	}
 
 	void addHeader(std::string name, std::string value);
 	void setHeader(std::string name, std::string value);
@@ -54,6 +97,16 @@ public:
 	void setConnClose(bool connClose);
 
 	bool headerExists(std::string name);
+	boost::optional<std::string> getHeader(std::string name);
+
+	bool isBodyChunked() const {
+		return !bodyIterator.isComplete();
+	}
+
+	bool isBodyPieceTransient(const std::string* piece) const {
+		//Compressed output is reused for the next piece.
+		return bodyCompressor || bodyIterator.isPieceTransient(piece);
+	}
 
 	std::string getResponseHeaders();
 	const std::string* getBodyNext();
@@ -0,0 +1,40 @@
+#include <sys/mman.h>
+#include <climits>
+#include "scoreboard.h"
+#include "except.h"
+
+#define DBG_DISABLE
+#include "dbg.h"
+
+
+Scoreboard::Scoreboard(int slotCount)
+	: slots(nullptr), slotCount(slotCount) {
+	if (slotCount <= 0) {
+		this->slotCount = 0;
+		return;
+	}
+
+	void* memory = mmap(NULL, sizeof(WorkerStatus) * slotCount, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) {
+		BOOST_THROW_EXCEPTION(syscallError() << stringInfo("mmap(): creating worker scoreboard") << errcodeInfoDef());
+	}
+	slots = (WorkerStatus*)memory;
+
+	for (int slot = 0; slot < slotCount; slot++) {
+		clearSlot(slot);
+	}
+}
+
+Scoreboard::~Scoreboard() {
+	if (slots != nullptr) {
+		munmap(slots, sizeof(WorkerStatus) * slotCount);
+	}
+}
+
+
+void Scoreboard::clearSlot(int slot) {
+	slots[slot].busy = 0;
+	slots[slot].pendingClients = 0;
+	slots[slot].minQueueDelayMs = INT_MAX;
+	slots[slot].clientsTaken = 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <atomic>
+
+/*
+	Per-worker status, kept in memory shared between the master and its workers.
+	Each worker only writes its own slot; the master reads them all.
+*/
+struct WorkerStatus
+{
+	std::atomic<int> busy;
+	std::atomic<int> pendingClients;
+	std::atomic<int> minQueueDelayMs;
+	//Clients taken from the dispatch pipe since the master last counted them.
+	std::atomic<int> clientsTaken;
+};
+
+
+class Scoreboard
+{
+	WorkerStatus* slots;
+	int slotCount;
+
+public:
+	explicit Scoreboard(int slotCount);
+	~Scoreboard();
+
+	Scoreboard(const Scoreboard&) = delete;
+	Scoreboard& operator=(const Scoreboard&) = delete;
+
+	int getSlotCount() const {
+		return slotCount;
+	}
+
+	WorkerStatus& getSlot(int slot) {
+		return slots[slot];
+	}
+
+	void clearSlot(int slot);
+};
@@ -1,4 +1,12 @@
 #include <unistd.h>
+#include <sched.h>
+#include <poll.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <climits>
+#include <stdlib.h>
 #include <ctime>
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string/trim.hpp>
@@ -6,6 +14,7 @@
 #include <functional>
 #include <string.h>
 #include <memory>
+#include <random>
 #include "utils.h"
 #include "server.h"
 #include "except.h"
@@ -19,6 +28,8 @@
 #include "rawPythonPymlParser.h"
 #include "signalManager.h"
 #include "config.h"
+#include "compression.h"
+#include "workStealingPool.h"
 
 #define DBG_DISABLE
 #include"dbg.h"
@@ -28,10 +39,15 @@ namespace b = boost;
 namespace bf = boost::filesystem;
 namespace ba = boost::algorithm;
 
+std::string replaceParams(std::string target, std::map<std::string, std::string> params);
+
 Server* Server::instance = nullptr;
 
-Server::Server(std::string serverRoot, int port)
+Server::Server(std::string serverRoot, int port, ServerOptions options)
 	:
+	options(options),
+	scoreboard(options.workers > 0 ? options.maxWorkers : 0),
+	staticScoreboard(options.staticThreads > 0 ? 1 : 0),
 	config(),
 	cacheController(config),
 	serverCache(
@@ -40,7 +56,8 @@ Server::Server(std::string serverRoot, int port)
 		          std::placeholders::_1,
 		          std::placeholders::_2,
 		          std::placeholders::_3),
-		std::bind(&Server::onServerCacheMiss, this, std::placeholders::_1)) {
+		std::bind(&Server::onServerCacheMiss, this, std::placeholders::_1)),
+	openFileCache(0, 0) {
 
 	if (Server::instance != nullptr) {
 		BOOST_THROW_EXCEPTION(serverError() << stringInfo("Multiple Server instances!"));
@@ -48,12 +65,30 @@ Server::Server(std::string serverRoot, int port)
 	Server::instance = this;
 
 	this->serverRoot = bf::path(serverRoot);
+	this->serverPort = port;
 	socketToClose = -1;
+	childSignalFd = -1;
+	lastTick = 0;
+	targetWorkers = options.workers;
+	staticPid = 0;
+	scaleUpTicks = 0;
+	scaleDownTicks = 0;
+	workerStartTime = 0;
+	workerRequestsServed = 0;
+	workerRecycling = false;
+	overloaded = false;
+	delayIntervalStart = 0;
+	clientsInFlight = 0;
+	staticClientsInFlight = 0;
+	previousGenerationPid = 0;
+	reloadRequested = false;
 
 	DBG("routes got");
 
 	try {
-		this->serverSocket = getServerSocket(port, false, true);
+		if (!getInheritedServerSocket()) {
+			this->serverSocket = getServerSocket(port, false, true, options.reusePort);
+		}
 	}
 	catch (networkError err) {
 		Loggers::errLogger.log("Could not get server socket.");
@@ -74,87 +109,1070 @@ Server::Server(std::string serverRoot, int port)
 	DBG("python initialized");
 
 	loadContentTypeList();
+	renderOverloadResponse();
 
 	DBG("mime.types initialized.");
 
-	config.load();
-	cacheController.load();
+	config.load();
+	cacheController.load();
+	setSendTimeout(config.getSendTimeoutMs());
+	openFileCache = OpenFileCache(config.getOpenFileCacheSize(), config.getOpenFileCacheValidSec());
+	checkOpenFileLimit();
+
+	if (previousGenerationPid != 0) {
+		warmUpCache();
+	}
+	if (options.noRequestFork) {
+		try {
+			PythonModule::saveRequestState();
+		}
+		catch (pythonError& err) {
+			Loggers::logErr(formatString("Error saving the Python state: %1%", err.what()));
+			exit(1);
+		}
+	}
+
+	Loggers::logInfo(formatString("Server initialized on port %1%", port));
+
+	stdinDisconnected = fdClosed(0);
+	
+	shutdownRequested = false;
+}
+
+
+Server::~Server() {
+	if (socketToClose != -1) {
+		close(socketToClose);
+	}
+}
+
+void Server::runServer() {
+	//With reusePort, each worker listens on its own socket; the master's only keeps the port bound.
+	//It must not listen, or the kernel would give it a share of the connections.
+	if (!options.reusePort) {
+		try {
+			setSocketListen(this->serverSocket);
+		}
+		catch (networkError err) {
+			Loggers::errLogger.log("Could not set server to listen.");
+			exit(1);
+		}
+	}
+	Loggers::logInfo("Server listening");
+
+	childSignalFd = SignalManager::createChildSignalFd();
+
+	if (options.workers > 0) {
+		Loggers::logInfo(formatString("Starting %1% workers", options.workers));
+		maintainWorkers();
+	}
+	if (options.staticThreads > 0) {
+		Loggers::logInfo(formatString("Starting the static file process with %1% threads", options.staticThreads));
+		maintainStaticProcess();
+		eventLoop.addFd(staticHandbackPipe.getReadHead(), EPOLLIN, [this](uint32_t) { receiveStaticHandbacks(); });
+	}
+	if (masterAccepts()) {
+		eventLoop.addFd(serverSocket, EPOLLIN, [this](uint32_t) { acceptConnections(); });
+	}
+	eventLoop.addFd(cacheRequestPipe.getReadHead(), EPOLLIN, [this](uint32_t) { updateParentCaches(); });
+	eventLoop.addFd(childSignalFd, EPOLLIN, [this](uint32_t) { onChildSignal(); });
+	eventLoop.addFd(idleClientPipe.getReadHead(), EPOLLIN, [this](uint32_t) { receiveIdleClients(); });
+	if (!stdinDisconnected && !eventLoop.addFd(0, EPOLLIN, [this](uint32_t) { tryCheckStdinClosed(); })) {
+		Loggers::logInfo("stdin can't be watched; it won't be checked for closing.");
+	}
+
+	//We're ready to take over; let the previous generation finish what it has and exit.
+	if (previousGenerationPid != 0) {
+		Loggers::logInfo(formatString("Taking over from process %1%", previousGenerationPid));
+		kill(previousGenerationPid, SIGUSR2);
+		previousGenerationPid = 0;
+	}
+
+	if (config.getPrecompressStatic()) {
+		startPrecompression();
+	}
+
+	while (!shutdownRequested) {
+		eventLoop.runOnce(1000);
+		onTick();
+
+		if (reloadRequested) {
+			reloadRequested = false;
+			startNextGeneration();
+		}
+	}
+}
+
+void Server::requestShutdown() {
+	shutdownRequested = true;
+}
+
+void Server::requestReload() {
+	reloadRequested = true;
+}
+
+void Server::cleanup() {
+}
+
+
+void Server::acceptConnections() {
+	std::vector<int> clientSockets;
+	try {
+		clientSockets = getNewClients(serverSocket, options.acceptBatch);
+	}
+	catch (networkError err) {
+		Loggers::errLogger.log("Could not get new client.");
+		exit(1);
+	}
+
+	for (int clientSocket : clientSockets) {
+		admitClient(clientSocket);
+	}
+}
+
+//With maxPending set, turns away clients (with a 503) once the queue is full or its delay is too long.
+void Server::admitClient(int clientSocket) {
+	long long nowMs = getMonotonicMs();
+
+	if (options.maxPending > 0) {
+		int pending = options.workers == 0 ? (int)connectionPids.size() : countPendingClients();
+		if (pending >= options.maxPending || checkOverloaded(nowMs)) {
+			rejectClient(clientSocket, overloadResponse);
+			lingerClient(clientSocket);
+			return;
+		}
+	}
+
+	dispatchReadyClient(clientSocket, nowMs);
+}
+
+//Clients admitted but not yet taken by a worker or a static pool thread: those in the dispatch pipes,
+//and those waiting for room in them.
+int Server::countPendingClients() {
+	for (int slot = 0; slot < scoreboard.getSlotCount(); slot++) {
+		clientsInFlight -= scoreboard.getSlot(slot).clientsTaken.exchange(0);
+	}
+	clientsInFlight = std::max(0, clientsInFlight);
+	return clientsInFlight + (int)dispatchBacklog.size() + countStaticClients();
+}
+
+//Like CoDel: the server is overloaded while even the shortest queueing delay over an interval
+//stays above the target. Workers report the delays of the clients they take from the master.
+bool Server::checkOverloaded(long long nowMs) {
+	const long long intervalMs = std::max(100, options.queueDelayTargetMs);
+	if (nowMs - delayIntervalStart < intervalMs) {
+		return overloaded;
+	}
+	delayIntervalStart = nowMs;
+
+	long long minDelayMs = INT_MAX;
+	for (int slot = 0; slot < scoreboard.getSlotCount(); slot++) {
+		minDelayMs = std::min(minDelayMs, (long long)scoreboard.getSlot(slot).minQueueDelayMs.exchange(INT_MAX));
+	}
+	if (minDelayMs == INT_MAX) {
+		//Nobody took a client this interval; the oldest one still waiting tells how bad it is.
+		minDelayMs = dispatchBacklog.empty() ? 0 : nowMs - dispatchBacklog.front().admittedMs;
+	}
+
+	bool wasOverloaded = overloaded;
+	overloaded = minDelayMs > options.queueDelayTargetMs;
+	if (overloaded != wasOverloaded) {
+		Loggers::logInfo(formatString(overloaded ? "Overloaded (queueing delay %1% ms), shedding new clients" :
+			"No longer overloaded (queueing delay %1% ms)", minDelayMs));
+	}
+	return overloaded;
+}
+
+void Server::renderOverloadResponse() {
+	//Rendered once, so rejecting a client costs the master next to nothing.
+	const int retryAfterSec = 1;
+	Response response(503, "<html><body><h1>503 Service Unavailable</h1></body></html>", true);
+	response.setHeader("Retry-After", std::to_string(retryAfterSec));
+	response.setHeader("Content-Type", "text/html");
+
+	overloadResponse = response.getResponseHeaders();
+	const std::string* bodyNext;
+	while ((bodyNext = response.getBodyNext()) != NULL) {
+		overloadResponse += *bodyNext;
+	}
+}
+
+void Server::dispatchClient(int clientSocket) {
+	pid_t pid = fork();
+	if (pid == -1) {
+		Loggers::logErr(formatString("Could not fork to serve a client (errno %1%); is the system out of resources?", errno));
+		rejectClient(clientSocket, overloadResponse);
+		lingerClient(clientSocket);
+		return;
+	}
+	if (pid == 0) {
+		initChildProcess();
+		socketToClose = clientSocket;
+
+		closeSocket(serverSocket);
+		clientDispatchPipe.closeRead();
+
+		serveClient(clientSocket);
+		exit(0);
+	}
+	closeSocket(clientSocket);
+
+	SignalManager::addPid((int)pid);
+	connectionPids.insert((int)pid);
+}
+
+
+void Server::onChildSignal() {
+	SignalManager::drainSignalFd(childSignalFd);
+	SignalManager::waitStoppedChildren();
+
+	for (auto it = connectionPids.begin(); it != connectionPids.end();) {
+		it = SignalManager::hasPid(*it) ? std::next(it) : connectionPids.erase(it);
+	}
+
+	if (options.workers > 0) {
+		maintainWorkers();
+	}
+	if (options.staticThreads > 0) {
+		maintainStaticProcess();
+	}
+}
+
+//Drops what only the master needs in a freshly forked child.
+void Server::initChildProcess() {
+	SignalManager::clearPids();
+	cacheRequestPipe.closeRead();
+	idleClientPipe.closeRead();
+	clientDispatchPipe.closeWrite();
+	eventLoop.close();
+	idleClients.clear();
+	lingeringClients.clear();
+	dispatchBacklog.clear();
+	connectionPids.clear();
+
+	SignalManager::restoreChildSignal(childSignalFd);
+	childSignalFd = -1;
+}
+
+
+void Server::maintainWorkers() {
+	workerPids.resize((size_t)options.maxWorkers, 0);
+
+	for (int slot = 0; slot < targetWorkers && !shutdownRequested; slot++) {
+		if ((workerPids[slot] == 0 || !SignalManager::hasPid(workerPids[slot])) && !spawnWorker(slot)) {
+			//Likely short of memory or processes; the next tick tries again.
+			break;
+		}
+	}
+}
+
+//Scales the pool between minWorkers and maxWorkers. Growing needs load for a couple of seconds,
+//shrinking needs a quiet pool for longer, so short bursts don't make it thrash.
+void Server::adjustWorkerCount() {
+	const double scaleUpRatio = 0.9;
+	const double scaleDownRatio = 0.5;
+	const int scaleUpDelay = 2;
+	const int scaleDownDelay = 15;
+
+	if (options.workers == 0 || options.minWorkers == options.maxWorkers) {
+		return;
+	}
+
+	int liveWorkers = 0;
+	int busyWorkers = 0;
+	int pendingClients = countPendingClients();
+	for (int slot = 0; slot < targetWorkers; slot++) {
+		if (workerPids[slot] != 0 && SignalManager::hasPid(workerPids[slot])) {
+			liveWorkers++;
+			busyWorkers += scoreboard.getSlot(slot).busy;
+			pendingClients += scoreboard.getSlot(slot).pendingClients;
+		}
+	}
+	if (!options.reusePort) {
+		pendingClients += getListenQueueLength(serverSocket);
+	}
+	double busyRatio = liveWorkers == 0 ? 1.0 : (double)busyWorkers / liveWorkers;
+
+	if (pendingClients > 0 || busyRatio >= scaleUpRatio) {
+		scaleDownTicks = 0;
+		if (++scaleUpTicks >= scaleUpDelay && targetWorkers < options.maxWorkers) {
+			scaleUpTicks = 0;
+			targetWorkers = std::min(options.maxWorkers, targetWorkers + std::max(1, targetWorkers / 4));
+			Loggers::logInfo(formatString("Scaling up to %1% workers (%2% pending, %3%/%4% busy)",
+				targetWorkers, pendingClients, busyWorkers, liveWorkers));
+			maintainWorkers();
+		}
+	}
+	else if (busyRatio < scaleDownRatio) {
+		scaleUpTicks = 0;
+		if (++scaleDownTicks >= scaleDownDelay && targetWorkers > options.minWorkers) {
+			scaleDownTicks = 0;
+			targetWorkers--;
+			Loggers::logInfo(formatString("Scaling down to %1% workers", targetWorkers));
+			//The worker finishes its current client, then exits; its slot isn't refilled.
+			if (workerPids[targetWorkers] != 0 && SignalManager::hasPid(workerPids[targetWorkers])) {
+				kill(workerPids[targetWorkers], SIGUSR2);
+			}
+		}
+	}
+	else {
+		scaleUpTicks = 0;
+		scaleDownTicks = 0;
+	}
+}
+
+//Each open file cache entry can hold three descriptors (the file, .gz and .br); a full cache shouldn't use up
+//more than half of what a process may open.
+void Server::checkOpenFileLimit() {
+	rlimit fdLimit;
+	size_t cacheFds = config.getOpenFileCacheSize() * 3;
+	if (getrlimit(RLIMIT_NOFILE, &fdLimit) == 0 && fdLimit.rlim_cur != RLIM_INFINITY && cacheFds > fdLimit.rlim_cur / 2) {
+		Loggers::logErr(formatString("Warning: open_file_cache_size %1% can hold up to %2% file descriptors, "
+			"but the open file limit is %3%; lower it or raise the limit (ulimit -n).",
+			config.getOpenFileCacheSize(), cacheFds, fdLimit.rlim_cur));
+	}
+}
+
+//Returns false if the worker couldn't be forked; its slot stays empty until the next try.
+bool Server::spawnWorker(int slot) {
+	//What the previous worker in the slot took still counts.
+	countPendingClients();
+	scoreboard.clearSlot(slot);
+
+	pid_t pid = fork();
+	if (pid == -1) {
+		Loggers::logErr(formatString("Could not fork worker for slot %1% (errno %2%); is the system out of resources?",
+			slot, errno));
+		workerPids[slot] = 0;
+		return false;
+	}
+	if (pid == 0) {
+		initChildProcess();
+
+		runWorker(slot);
+		exit(0);
+	}
+
+	workerPids[slot] = (int)pid;
+	SignalManager::addPid((int)pid);
+	return true;
+}
+
+void Server::runWorker(int slot) {
+	const int timeout = 100;
+	pid_t masterPid = getppid();
+	Loggers::logInfo(formatString("Worker %1% started in slot %2%", getpid(), slot));
+	workerStartTime = std::time(NULL);
+
+	setWorkerAffinity(slot);
+
+	if (options.reusePort) {
+		closeSocket(serverSocket);
+		try {
+			serverSocket = getServerSocket(serverPort, true, true, true);
+		}
+		catch (networkError& err) {
+			Loggers::logErr(formatString("Worker could not get its server socket: %1%", err.what()));
+			exit(1);
+		}
+		socketToClose = serverSocket;
+	}
+
+	//Stop when asked to, or when the master is gone (and can't supervise us anymore).
+	//A recycled worker exits like any other; the master replaces it with a fresh fork.
+	while (!shutdownRequested && getppid() == masterPid && !workerRecycleDue()) {
+		int clientSocket = -1;
+		try {
+			clientSocket = getWorkerClient(slot, timeout);
+		}
+		catch (networkError& err) {
+			Loggers::logErr(formatString("Worker could not get new client: %1%", err.what()));
+			exit(1);
+		}
+
+		if (clientSocket == -1) {
+			scoreboard.getSlot(slot).pendingClients = 0;
+			continue;
+		}
+
+		WorkerStatus& status = scoreboard.getSlot(slot);
+		if (options.reusePort) {
+			status.pendingClients = getListenQueueLength(serverSocket);
+		}
+		status.busy = 1;
+		serveClient(clientSocket);
+		status.busy = 0;
+	}
+
+	//Our listening socket's queue dies with it, whether we're shutting down or being recycled.
+	//Take every client already waiting there, then close it so the kernel sends new ones to the other workers,
+	//and only then serve the ones we took.
+	if (options.reusePort && (shutdownRequested || workerRecycling)) {
+		std::vector<int> queuedClients;
+		try {
+			std::vector<int> batch;
+			do {
+				batch = getNewClients(serverSocket, options.acceptBatch);
+				queuedClients.insert(queuedClients.end(), batch.begin(), batch.end());
+			} while ((int)batch.size() == options.acceptBatch);
+		}
+		catch (networkError& err) {
+			Loggers::logErr(formatString("Worker could not drain its server socket: %1%", err.what()));
+		}
+		closeSocket(serverSocket);
+		serverSocket = -1;
+		socketToClose = -1;
+
+		for (int clientSocket : queuedClients) {
+			serveClient(clientSocket);
+		}
+	}
+
+	Loggers::logInfo(formatString("Worker %1% exiting", getpid()));
+}
+
+//Checks the limits after which a worker is replaced, to keep its memory from growing over time.
+bool Server::workerRecycleDue() {
+	if (workerStartTime == 0 || workerRecycling) {
+		return workerRecycling;
+	}
+
+	std::time_t age = std::time(NULL) - workerStartTime;
+	long rssKb = options.maxWorkerRssKb > 0 ? getResidentMemoryKb() : -1;
+
+	if (options.maxWorkerRequests > 0 && workerRequestsServed >= options.maxWorkerRequests) {
+		Loggers::logInfo(formatString("Recycling worker %1% after %2% requests", getpid(), workerRequestsServed));
+		workerRecycling = true;
+	}
+	else if (options.maxWorkerAgeSec > 0 && age >= options.maxWorkerAgeSec) {
+		Loggers::logInfo(formatString("Recycling worker %1% after %2% seconds", getpid(), age));
+		workerRecycling = true;
+	}
+	else if (options.maxWorkerRssKb > 0 && rssKb >= options.maxWorkerRssKb) {
+		Loggers::logInfo(formatString("Recycling worker %1% at %2% KB resident", getpid(), rssKb));
+		workerRecycling = true;
+	}
+	return workerRecycling;
+}
+
+void Server::setWorkerAffinity(int slot) {
+	if (options.cpuAffinity.empty()) {
+		return;
+	}
+
+	int cpu = options.cpuAffinity[slot % options.cpuAffinity.size()];
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	CPU_SET(cpu, &cpuSet);
+
+	if (sched_setaffinity(0, sizeof(cpuSet), &cpuSet) != 0) {
+		Loggers::logErr(formatString("Could not pin worker %1% to CPU %2% (errno %3%)", getpid(), cpu, errno));
+	}
+}
+
+
+//Waits for either a new connection or one the master dispatched to us.
+//When the master admits the clients, the listener is left to it.
+int Server::getWorkerClient(int slot, int timeoutMs) {
+	pollfd pfds[2];
+	pfds[0].fd = clientDispatchPipe.getReadHead();
+	pfds[0].events = POLLIN;
+	pfds[0].revents = 0;
+	pfds[1].fd = serverSocket;
+	pfds[1].events = POLLIN;
+	pfds[1].revents = 0;
+
+	int pollResult = poll(pfds, masterAccepts() ? 1 : 2, timeoutMs);
+	if (pollResult == -1) {
+		if (errno == EINTR) {
+			return -1;
+		}
+		BOOST_THROW_EXCEPTION(networkError() << stringInfo("poll(): waiting for worker client.") << errcodeInfoDef());
+	}
+
+	if (pfds[0].revents & POLLIN) {
+		int64_t admittedMs;
+		int clientSocket = clientDispatchPipe.pipeRead(&admittedMs);
+		if (clientSocket != -1) {
+			int delayMs = (int)(getMonotonicMs() - admittedMs);
+			WorkerStatus& status = scoreboard.getSlot(slot);
+			status.clientsTaken++;
+			if (delayMs < status.minQueueDelayMs) {
+				status.minQueueDelayMs = delayMs;
+			}
+			return clientSocket;
+		}
+	}
+	if (!masterAccepts() && (pfds[1].revents & POLLIN)) {
+		return getNewClient(serverSocket, 0);
+	}
+	return -1;
+}
+
+//The workers accept by themselves, unless the master has to decide which connections to admit or where they go.
+bool Server::masterAccepts() const {
+	return options.workers == 0 || options.maxPending > 0 || options.staticThreads > 0;
+}
+
+
+//Hands a keep-alive client that stays quiet back to the master, so it doesn't hold this process.
+//Returns false if the client should be kept here.
+bool Server::parkIdleClient(int clientSocket) {
+	if (options.keepAliveParkMs < 0 || waitSocketReadable(clientSocket, options.keepAliveParkMs)) {
+		return false;
+	}
+
+	int64_t timeoutLeftSec = std::max(1, keepAliveTimeoutSec - options.keepAliveParkMs / 1000);
+	return idleClientPipe.pipeWrite(clientSocket, timeoutLeftSec);
+}
+
+void Server::receiveIdleClients() {
+	int64_t timeoutSec;
+	int clientSocket;
+	while ((clientSocket = idleClientPipe.pipeRead(&timeoutSec)) != -1) {
+		watchIdleClient(clientSocket, std::time(NULL) + (std::time_t)timeoutSec);
+	}
+}
+
+//Waits (in the event loop) for the client to send something, until expiry.
+void Server::watchIdleClient(int clientSocket, std::time_t expiry) {
+	if (!eventLoop.addFd(clientSocket, EPOLLIN, [this, clientSocket](uint32_t) { onIdleClientEvent(clientSocket); })) {
+		closeSocket(clientSocket);
+		return;
+	}
+	idleClients[clientSocket] = expiry;
+}
+
+void Server::onIdleClientEvent(int clientSocket) {
+	int state = peekSocketState(clientSocket);
+	if (state == 0) {
+		return;
+	}
+
+	eventLoop.removeFd(clientSocket);
+	idleClients.erase(clientSocket);
+
+	if (state == -1) {
+		closeSocket(clientSocket);
+	}
+	else {
+		dispatchReadyClient(clientSocket, getMonotonicMs());
+	}
+}
+
+void Server::dispatchReadyClient(int clientSocket, long long admittedMs) {
+	if (options.staticThreads > 0) {
+		//Where the client goes depends on its request; wait for it without holding anyone.
+		int state = peekSocketState(clientSocket);
+		if (state == -1) {
+			closeSocket(clientSocket);
+			return;
+		}
+		if (state == 0) {
+			watchIdleClient(clientSocket, std::time(NULL) + maxKeepAliveSec);
+			return;
+		}
+
+		//Only requests for static files go to the static process. If all its threads are busy,
+		//the workers serve static files just as well.
+		if (isStaticRequest(clientSocket) && staticPoolHasRoom() && staticDispatchPipe.pipeWrite(clientSocket, admittedMs)) {
+			closeSocket(clientSocket);
+			staticClientsInFlight++;
+			return;
+		}
+	}
+
+	dispatchDynamicClient(clientSocket, admittedMs);
+}
+
+//Decided from the request head and the routes alone; the master doesn't wait on the disk. Targets without
+//an extension are usually directories with an index page, so they go to the workers. The static process
+//hands back anything it turns out it can't send.
+bool Server::isStaticRequest(int clientSocket) {
+	size_t headLength;
+	b::optional<Request> request = peekRequestHead(clientSocket, &headLength);
+	if (!request) {
+		return false;
+	}
+
+	b::optional<std::string> target = getStaticRouteTarget(*request);
+	return target && bf::path(*target).has_extension() && isStaticFile(*target);
+}
+
+//Clients sent to the static process that no pool thread has taken yet.
+int Server::countStaticClients() {
+	if (options.staticThreads == 0) {
+		return 0;
+	}
+
+	staticClientsInFlight -= staticScoreboard.getSlot(0).clientsTaken.exchange(0);
+	staticClientsInFlight = std::max(0, staticClientsInFlight);
+	return staticClientsInFlight;
+}
+
+//A slow client holds its pool thread for the whole send; once every thread is busy or spoken for,
+//queueing more clients there only makes them wait.
+bool Server::staticPoolHasRoom() {
+	return countStaticClients() + staticScoreboard.getSlot(0).busy < options.staticThreads;
+}
+
+void Server::dispatchDynamicClient(int clientSocket, long long admittedMs) {
+	if (options.workers == 0) {
+		dispatchClient(clientSocket);
+		return;
+	}
+
+	if (dispatchBacklog.empty() && clientDispatchPipe.pipeWrite(clientSocket, admittedMs)) {
+		//The descriptor in flight keeps the connection open.
+		closeSocket(clientSocket);
+		clientsInFlight++;
+		return;
+	}
+
+	//The workers are behind; wait until the pipe can take more.
+	if (dispatchBacklog.empty()) {
+		eventLoop.addFd(clientDispatchPipe.getWriteHead(), EPOLLOUT, [this](uint32_t) { flushDispatchBacklog(); });
+	}
+	dispatchBacklog.push_back(PendingClient{clientSocket, admittedMs});
+}
+
+void Server::flushDispatchBacklog() {
+	while (!dispatchBacklog.empty() &&
+		clientDispatchPipe.pipeWrite(dispatchBacklog.front().socket, dispatchBacklog.front().admittedMs)) {
+		closeSocket(dispatchBacklog.front().socket);
+		dispatchBacklog.pop_front();
+		clientsInFlight++;
+	}
+
+	if (dispatchBacklog.empty()) {
+		eventLoop.removeFd(clientDispatchPipe.getWriteHead());
+	}
+}
+
+
+void Server::maintainStaticProcess() {
+	if (shutdownRequested || (staticPid != 0 && SignalManager::hasPid(staticPid))) {
+		return;
+	}
+
+	//The previous process's threads are gone; the clients it left in the pipe are still waiting.
+	countStaticClients();
+	staticScoreboard.clearSlot(0);
+
+	pid_t pid = fork();
+	if (pid == -1) {
+		//The workers serve static files meanwhile; the next tick tries again.
+		Loggers::logErr(formatString("Could not fork the static file process (errno %1%); is the system out of resources?", errno));
+		staticPid = 0;
+		return;
+	}
+	if (pid == 0) {
+		initChildProcess();
+
+		runStaticProcess();
+		exit(0);
+	}
+
+	staticPid = (int)pid;
+	SignalManager::addPid((int)pid);
+}
+
+//Serves static files from a pool of threads, with no Python and no forking. Only the pool threads
+//touch the clients; this thread just takes them from the master.
+void Server::runStaticProcess() {
+	const int timeout = 100;
+	pid_t masterPid = getppid();
+	Loggers::logInfo(formatString("Static file process %1% started", getpid()));
+
+	closeSocket(serverSocket);
+	clientDispatchPipe.closeRead();
+
+	//All the threads share this process's descriptors, so they share the configured cache size too.
+	size_t threadCacheSize = config.getOpenFileCacheSize() == 0 ? 0 :
+		std::max((size_t)1, config.getOpenFileCacheSize() / (size_t)options.staticThreads);
+	staticFileCaches.assign((size_t)options.staticThreads,
+		OpenFileCache(threadCacheSize, config.getOpenFileCacheValidSec()));
+	WorkStealingPool pool((size_t)options.staticThreads);
+
+	while (!shutdownRequested && getppid() == masterPid) {
+		try {
+			if (!waitSocketReadable(staticDispatchPipe.getReadHead(), timeout)) {
+				continue;
+			}
+		}
+		catch (networkError& err) {
+			Loggers::logErr(formatString("Static file process could not wait for clients: %1%", err.what()));
+			break;
+		}
+
+		int64_t admittedMs;
+		int clientSocket;
+		while ((clientSocket = staticDispatchPipe.pipeRead(&admittedMs)) != -1) {
+			pool.submit([this, clientSocket, admittedMs](size_t threadIdx) {
+				WorkerStatus& status = staticScoreboard.getSlot(0);
+				status.busy++;
+				status.clientsTaken++;
+				serveStaticClient(clientSocket, admittedMs, threadIdx);
+				status.busy--;
+			});
+		}
+	}
+
+	pool.stop();
+	Loggers::logInfo(formatString("Static file process %1% exiting", getpid()));
+}
+
+//Runs on a pool thread. Serves the client's requests while they are for static files, then leaves the client
+//to the master when it goes quiet, or to the workers at the first request for anything else.
+//The request is only taken off the socket once it's known to be ours, so whoever gets the client next sees all of it.
+void Server::serveStaticClient(int clientSocket, long long admittedMs, size_t threadIdx) {
+	int keepAliveSec = maxKeepAliveSec;
+
+	try {
+		while (true) {
+			int state = peekSocketState(clientSocket);
+			if (state == -1) {
+				break;
+			}
+			if (state == 0) {
+				if (!idleClientPipe.pipeWrite(clientSocket, keepAliveSec)) {
+					handBackStaticClient(clientSocket, admittedMs);
+					return;
+				}
+				break;
+			}
+
+			size_t headLength;
+			b::optional<Request> request = peekRequestHead(clientSocket, &headLength);
+			std::shared_ptr<const OpenFile> file;
+			if (request) {
+				file = getStaticTarget(*request, staticFileCaches[threadIdx]);
+			}
+			if (!file) {
+				handBackStaticClient(clientSocket, admittedMs);
+				return;
+			}
+			discardSocketData(clientSocket, headLength);
+
+			keepAliveSec = std::min(maxKeepAliveSec, request->getKeepAliveTimeout());
+			bool keepAliveStatic = request->isKeepAlive() && keepAliveSec != 0;
+
+			respondWithStaticFile(clientSocket, *request, file, keepAliveStatic);
+
+			if (!keepAliveStatic) {
+				break;
+			}
+			admittedMs = getMonotonicMs();
+		}
+	}
+	catch (networkError&) {
+		Loggers::logErr("Client disconnected.");
+	}
+	catch (rootException& ex) {
+		Loggers::logErr(formatString("Error serving static file: %1%", ex.what()));
+	}
+
+	closeSocket(clientSocket);
+}
+
+void Server::handBackStaticClient(int clientSocket, long long admittedMs) {
+	const int retryMs = 100;
+	const int retries = 50;
+
+	for (int i = 0; i < retries; i++) {
+		if (staticHandbackPipe.pipeWrite(clientSocket, admittedMs)) {
+			closeSocket(clientSocket);
+			return;
+		}
+		pollfd pfd;
+		pfd.fd = staticHandbackPipe.getWriteHead();
+		pfd.events = POLLOUT;
+		pfd.revents = 0;
+		poll(&pfd, 1, retryMs);
+	}
+
+	Loggers::logErr("The master isn't taking clients back from the static file process; dropping one.");
+	rejectClient(clientSocket, overloadResponse);
+	drainBeforeClose(clientSocket);
+	closeSocket(clientSocket);
+}
+
+//The file a request is for, if the static process can send it: a plain GET or HEAD of a file with no Python in it.
+//Anything else, including files that aren't there, is left to the workers.
+std::shared_ptr<const OpenFile> Server::getStaticTarget(Request& request, OpenFileCache& fileCache) {
+	b::optional<std::string> routeTarget = getStaticRouteTarget(request);
+	//Pages are told apart by their names alone; they only touch the disk once, when they're rendered.
+	if (!routeTarget || !isStaticFile(*routeTarget)) {
+		return nullptr;
+	}
+
+	try {
+		const std::string& target = *routeTarget;
+		std::shared_ptr<const OpenFile> file;
+		if (fileCache.get(target, &file)) {
+			return file;
+		}
+
+		std::string filename = expandFilename(target);
+		if (!isStaticFile(filename) || !bf::is_regular_file(filename)) {
+			//Remembered as well (e.g. a directory with an index page), so it's not looked up on every request.
+			fileCache.put(target, nullptr);
+			return nullptr;
+		}
+		file = std::make_shared<const OpenFile>(filename, true);
+		fileCache.put(target, file);
+		return file;
+	}
+	catch (rootException&) {
+		return nullptr;
+	}
+	catch (bf::filesystem_error&) {
+		return nullptr;
+	}
+}
+
+//The file a plain GET or HEAD is routed to, before it's looked up on disk.
+b::optional<std::string> Server::getStaticRouteTarget(Request& request) {
+	if ((request.getVerb() != HttpVerb::GET && request.getVerb() != HttpVerb::HEAD) || request.isUpgrade("websocket")) {
+		return b::none;
+	}
 
-	Loggers::logInfo(formatString("Server initialized on port %1%", port));
+	try {
+		std::map<std::string, std::string> params;
+		std::string url = request.getUrl().to_string();
+		const Route& route = Route::getRouteMatch(config.getRoutes(), request.getRouteVerb(), url, params);
+		return getFilenameFromTarget(replaceParams(route.getTarget(url), params));
+	}
+	catch (rootException&) {
+		return b::none;
+	}
+}
 
-	stdinDisconnected = fdClosed(0);
-	
-	shutdownRequested = false;
+void Server::receiveStaticHandbacks() {
+	int64_t admittedMs;
+	int clientSocket;
+	while ((clientSocket = staticHandbackPipe.pipeRead(&admittedMs)) != -1) {
+		dispatchDynamicClient(clientSocket, admittedMs);
+	}
 }
 
+//Housekeeping that runs at most once a second.
+void Server::onTick() {
+	std::time_t now = std::time(NULL);
+	if (now == lastTick) {
+		return;
+	}
+	lastTick = now;
 
-Server::~Server() {
-	if (socketToClose != -1) {
-		close(socketToClose);
+	expireClients(idleClients, now);
+	expireClients(lingeringClients, now);
+	//Refills what a failed fork left empty.
+	if (options.workers > 0) {
+		maintainWorkers();
 	}
+	if (options.staticThreads > 0) {
+		maintainStaticProcess();
+	}
+	adjustWorkerCount();
 }
 
-void Server::runServer() {
-	try {
-		setSocketListen(this->serverSocket);
-	}
-	catch (networkError err) {
-		Loggers::errLogger.log("Could not set server to listen.");
-		exit(1);
+//Keeps a rejected client's connection until it stops sending (or for a couple of seconds), without blocking,
+//so closing it doesn't reset the connection before the client read the response.
+void Server::lingerClient(int clientSocket) {
+	const int lingerSec = 2;
+	if (!eventLoop.addFd(clientSocket, EPOLLIN, [this, clientSocket](uint32_t) { onLingeringClientEvent(clientSocket); })) {
+		closeSocket(clientSocket);
+		return;
 	}
-	Loggers::logInfo("Server listening");
+	lingeringClients[clientSocket] = std::time(NULL) + lingerSec;
+}
 
-	while (!shutdownRequested) {
-		tryAcceptConnection();
-		SignalManager::waitStoppedChildren();
-		updateParentCaches();
-		tryCheckStdinClosed();
+void Server::onLingeringClientEvent(int clientSocket) {
+	if (drainSocket(clientSocket)) {
+		return;
 	}
+	eventLoop.removeFd(clientSocket);
+	lingeringClients.erase(clientSocket);
+	closeSocket(clientSocket);
 }
 
-void Server::requestShutdown() {
-	shutdownRequested = true;
+void Server::expireClients(std::unordered_map<int, std::time_t>& clients, std::time_t now) {
+	for (auto it = clients.begin(); it != clients.end();) {
+		if (it->second <= now) {
+			eventLoop.removeFd(it->first);
+			closeSocket(it->first);
+			it = clients.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
 }
 
-void Server::cleanup() {
+
+//A reloading master passes its socket to the next generation through the environment.
+bool Server::getInheritedServerSocket() {
+	const char* listenFd = getenv("KRAIT_LISTEN_FD");
+	const char* previousPid = getenv("KRAIT_PREVIOUS_PID");
+	if (listenFd == NULL || previousPid == NULL) {
+		return false;
+	}
+
+	serverSocket = atoi(listenFd);
+	previousGenerationPid = atoi(previousPid);
+	unsetenv("KRAIT_LISTEN_FD");
+	unsetenv("KRAIT_PREVIOUS_PID");
+
+	if (fcntl(serverSocket, F_SETFD, FD_CLOEXEC) == -1) {
+		BOOST_THROW_EXCEPTION(networkError() << stringInfoFromFormat("fcntl(): taking over inherited server socket %1%", serverSocket) <<
+			errcodeInfoDef());
+	}
+	Loggers::logInfo(formatString("Using server socket inherited from process %1%", previousGenerationPid));
+	return true;
 }
 
+//Starts a new master (with the same command line) on our socket. It stops us when it's ready.
+void Server::startNextGeneration() {
+	Loggers::logInfo("Reload requested, starting a new server generation.");
+	pid_t masterPid = getpid();
 
-void Server::tryAcceptConnection() {
-	const int timeout = 100;
-	int clientSocket = -1;
-	try {
-		clientSocket = getNewClient(serverSocket, timeout);
+	pid_t pid = fork();
+	if (pid == -1) {
+		Loggers::logErr(formatString("Could not fork the new server generation (errno %1%)", errno));
+		return;
 	}
-	catch (networkError err) {
-		Loggers::errLogger.log("Could not get new client.");
+	if (pid == 0) {
+		initChildProcess();
+
+		//Fork again, so the new master isn't our child and outlives us.
+		pid_t execPid = fork();
+		if (execPid != 0) {
+			exit(execPid == -1 ? 1 : 0);
+		}
+
+		int flags = fcntl(serverSocket, F_GETFD);
+		if (flags == -1 || fcntl(serverSocket, F_SETFD, flags & ~FD_CLOEXEC) == -1) {
+			Loggers::logErr(formatString("Could not pass the server socket to the new generation (errno %1%)", errno));
+			exit(1);
+		}
+		setenv("KRAIT_LISTEN_FD", std::to_string(serverSocket).c_str(), 1);
+		setenv("KRAIT_PREVIOUS_PID", std::to_string(masterPid).c_str(), 1);
+
+		std::string kraitPath = (getExecRoot() / "krait").string();
+		std::vector<char*> args;
+		for (std::string& arg : options.commandLine) {
+			args.push_back(const_cast<char*>(arg.c_str()));
+		}
+		args.push_back(NULL);
+
+		execv(kraitPath.c_str(), args.data());
+		Loggers::logErr(formatString("Could not start the new server generation (errno %1%)", errno));
 		exit(1);
 	}
 
-	if (clientSocket == -1) {
-		return;
+	SignalManager::addPid((int)pid);
+}
+
+//Parses the site's templates ahead of time, so the workers inherit them ready to run.
+void Server::warmUpCache() {
+	int filesParsed = 0;
+	interpretCacheRequest = false;
+
+	try {
+		for (bf::recursive_directory_iterator it(serverRoot), end; it != end && !shutdownRequested; ++it) {
+			std::string filename = it->path().string();
+			if (!bf::is_regular_file(it->path()) || pathBlocked(filename) || isStaticFile(filename)) {
+				continue;
+			}
+
+			try {
+				serverCache.get(filename);
+				filesParsed++;
+			}
+			catch (rootException& ex) {
+				Loggers::logErr(formatString("Could not parse %1% ahead of time: %2%", filename, ex.what()));
+			}
+		}
+	}
+	catch (bf::filesystem_error& err) {
+		Loggers::logErr(formatString("Error walking the site root to warm up the cache: %1%", err.what()));
 	}
 
+	interpretCacheRequest = true;
+	Loggers::logInfo(formatString("Parsed %1% templates ahead of time", filesParsed));
+}
+
+
+//Writes .gz (and, if built with Brotli, .br) copies next to compressible static files that lack fresh ones.
+//Compressing a large site takes a while; a helper process does it while we serve. Until it's done,
+//files without compressed copies are simply sent as they are.
+void Server::startPrecompression() {
 	pid_t pid = fork();
 	if (pid == -1) {
-		BOOST_THROW_EXCEPTION(syscallError() << stringInfo("fork(): creating process to serve socket. Is the system out of resources?") <<
-			errcodeInfoDef());
+		Loggers::logErr(formatString("Could not fork to precompress static files (errno %1%)", errno));
+		return;
 	}
 	if (pid == 0) {
-		SignalManager::clearPids();
-		socketToClose = clientSocket;
-
+		initChildProcess();
 		closeSocket(serverSocket);
-		cacheRequestPipe.closeRead();
+		if (nice(10) == -1) {
+			DBG("Could not lower the precompression priority");
+		}
 
-		serveClientStart(clientSocket);
-		exit(255); //The function above should call exit()!
+		precompressStaticFiles();
+		exit(0);
 	}
-	closeSocket(clientSocket);
 
 	SignalManager::addPid((int)pid);
 }
 
+void Server::precompressStaticFiles() {
+	//Slower settings shrink the files little more, for much longer runs over a large site.
+	const int brotliQuality = 9;
+	const uintmax_t minFileSize = 1024;
+	int filesCompressed = 0;
+
+	try {
+		for (bf::recursive_directory_iterator it(serverRoot), end; it != end; ++it) {
+			std::string filename = it->path().string();
+			if (!bf::is_regular_file(it->path()) || pathBlocked(filename) || !isStaticFile(filename) ||
+				ba::ends_with(filename, ".gz") || ba::ends_with(filename, ".br") ||
+				bf::file_size(it->path()) < minFileSize || !isCompressibleType(getContentTypeByExtension(it->path().extension().string()))) {
+				continue;
+			}
+
+			std::time_t sourceTime = bf::last_write_time(it->path());
+			auto isStale = [sourceTime](const std::string& variantPath) {
+				return !bf::exists(variantPath) || bf::last_write_time(variantPath) < sourceTime;
+			};
+
+			if (isStale(filename + ".gz")) {
+				if (gzipFile(filename, filename + ".gz")) {
+					filesCompressed++;
+				}
+				else {
+					Loggers::logErr(formatString("Could not write %1%.gz", filename));
+				}
+			}
+#ifdef KRAIT_HAVE_BROTLI
+			if (isStale(filename + ".br")) {
+				if (brotliFile(filename, filename + ".br", brotliQuality)) {
+					filesCompressed++;
+				}
+				else {
+					Loggers::logErr(formatString("Could not write %1%.br", filename));
+				}
+			}
+#endif
+		}
+	}
+	catch (bf::filesystem_error& err) {
+		Loggers::logErr(formatString("Error walking the site root to precompress static files: %1%", err.what()));
+	}
+
+	Loggers::logInfo(formatString("Wrote %1% precompressed static files", filesCompressed));
+}
+
 
 void Server::tryCheckStdinClosed() const {
 	if (!stdinDisconnected && fdClosed(0)) {
@@ -162,16 +1180,17 @@ void Server::tryCheckStdinClosed() const {
 	}
 }
 
-std::string replaceParams(std::string target, std::map<std::string, std::string> params);
-
-void Server::serveClientStart(int clientSocket) {
+void Server::serveClient(int clientSocket) {
 	Loggers::logInfo("Serving a new client");
 	bool isHead = false;
 	keepAliveTimeoutSec = maxKeepAliveSec;
+	std::string pendingData;
 
 	try {
 		while (true) {
-			b::optional<Request> requestOpt = getRequestFromSocket(clientSocket, keepAliveTimeoutSec * 1000);
+			b::optional<Request> requestOpt = getRequestFromSocket(clientSocket, keepAliveTimeoutSec * 1000, pendingData,
+				config.getBodySpillThreshold(), config.getMaxBodySize(), std::bind(&Server::checkRequestHead, this, std::placeholders::_1,
+					std::placeholders::_2));
 			Loggers::logInfo(formatString("request got"));
 			if (!requestOpt) {
 				Loggers::logInfo(formatString("Requests finished."));
@@ -190,38 +1209,31 @@ void Server::serveClientStart(int clientSocket) {
 			keepAliveTimeoutSec = std::min(maxKeepAliveSec, request.getKeepAliveTimeout());
 			keepAlive = request.isKeepAlive() && keepAliveTimeoutSec != 0 && !request.isUpgrade("websocket");
 
-			pid_t childPid = fork();
-			if (childPid == 0) {
-				SignalManager::clearPids();
-
-				try {
-					if (request.isUpgrade("websocket")) {
-						startWebsocketsServer(clientSocket, request);
-					}
-					else {
-						serveRequest(clientSocket, request);
-					}
+			//A worker due for recycling closes the connection after this request, then exits.
+			workerRequestsServed++;
+			if (keepAlive && workerRecycleDue()) {
+				keepAlive = false;
+			}
 
-					Loggers::logInfo("Serving a request finished.");
-				}
-				catch (networkError&) {
-					Loggers::errLogger.log("Could not respond to client request.");
-					exit(1);
-				}
-				catch (pythonError& err) {
-					Loggers::errLogger.log(formatString("Python error:\n%1%", err.what()));
-					exit(1);
-				}
-				close(clientSocket);
-				exit(0);
+			//Static files need no Python, so they are sent from here, without forking;
+			//this is also what lets the open-file cache outlive a request.
+			std::shared_ptr<const OpenFile> staticFile = getStaticTarget(request, openFileCache);
+			if (staticFile) {
+				respondWithStaticFile(clientSocket, request, staticFile, keepAlive);
+			}
+			else if (options.noRequestFork) {
+				serveRequestInProcess(clientSocket, request);
 			}
 			else {
-				SignalManager::addPid((int)childPid);
-				SignalManager::waitChild((int)childPid);
-				Loggers::logInfo("Rejoined with forked request server.");
+				serveRequestForked(clientSocket, request);
 			}
 
-			if (!keepAlive) {
+			if (!keepAlive || shutdownRequested) {
+				break;
+			}
+			//Pipelined requests already read are served here; the master would never see them.
+			if (pendingData.empty() && parkIdleClient(clientSocket)) {
+				Loggers::logInfo("Client idle, handed to the master.");
 				break;
 			}
 		}
@@ -241,8 +1253,94 @@ void Server::serveClientStart(int clientSocket) {
 
 
 	close(clientSocket);
+}
+
+//Decides on a request body before it is read (see RequestHeadHandler).
+//Clients that sent "Expect: 100-continue" wait for our answer before sending the body.
+int Server::checkRequestHead(const Request& head, unsigned long long bodyLength) {
+	b::optional<std::string> expect = head.getHeader("Expect");
+	if (expect && !ba::iequals(*expect, "100-continue")) {
+		return 417;
+	}
+	if (config.getMaxBodySize() != 0 && bodyLength > config.getMaxBodySize()) {
+		return 413;
+	}
+	//HTTP/1.0 clients don't know about 100 Continue.
+	if (!expect || head.getHttpMajor() < 1 || (head.getHttpMajor() == 1 && head.getHttpMinor() == 0)) {
+		return 0;
+	}
+
+	//Don't ask for a body that can't be routed anywhere.
+	std::map<std::string, std::string> params;
+	try {
+		Route::getRouteMatch(config.getRoutes(), head.getRouteVerb(), head.getUrl().to_string(), params);
+	}
+	catch (routeError&) {
+		return 417;
+	}
+	return 100;
+}
+
+
+void Server::serveRequestForked(int clientSocket, Request& request) {
+	pid_t childPid = fork();
+	if (childPid == -1) {
+		BOOST_THROW_EXCEPTION(syscallError() << stringInfo("fork(): creating process to serve request. Is the system out of resources?") <<
+			errcodeInfoDef());
+	}
+	if (childPid == 0) {
+		SignalManager::clearPids();
+
+		try {
+			if (request.isUpgrade("websocket")) {
+				startWebsocketsServer(clientSocket, request);
+			}
+			else {
+				serveRequest(clientSocket, request);
+			}
+
+			Loggers::logInfo("Serving a request finished.");
+		}
+		catch (networkError&) {
+			Loggers::errLogger.log("Could not respond to client request.");
+			exit(1);
+		}
+		catch (pythonError& err) {
+			Loggers::errLogger.log(formatString("Python error:\n%1%", err.what()));
+			exit(1);
+		}
+		close(clientSocket);
+		exit(0);
+	}
+	else {
+		SignalManager::addPid((int)childPid);
+		SignalManager::waitChild((int)childPid);
+		Loggers::logInfo("Rejoined with forked request server.");
+	}
+}
+
+void Server::serveRequestInProcess(int clientSocket, Request& request) {
+	try {
+		if (request.isUpgrade("websocket")) {
+			startWebsocketsServer(clientSocket, request);
+		}
+		else {
+			serveRequest(clientSocket, request);
+		}
+
+		Loggers::logInfo("Serving a request finished.");
+	}
+	catch (networkError&) {
+		PythonModule::restoreRequestState();
+		throw;
+	}
+	catch (pythonError& err) {
+		Loggers::errLogger.log(formatString("Python error:\n%1%", err.what()));
+		keepAlive = false;
+	}
 
-	exit(0);
+	//Undo whatever the request did to the Python globals, as a fresh fork would.
+	PythonModule::restoreRequestState();
 }
 
 void Server::serveRequest(int clientSocket, Request& request) {
@@ -255,9 +1353,10 @@ void Server::serveRequest(int clientSocket, Request& request) {
 			isHead = true;
 		}
 		std::map<std::string, std::string> params;
-		const Route& route = Route::getRouteMatch(config.getRoutes(), request.getRouteVerb(), request.getUrl(), params);
+		std::string url = request.getUrl().to_string();
+		const Route& route = Route::getRouteMatch(config.getRoutes(), request.getRouteVerb(), url, params);
 
-		std::string targetReplaced = replaceParams(route.getTarget(request.getUrl()), params);
+		std::string targetReplaced = replaceParams(route.getTarget(url), params);
 		std::string sourceFile = getFilenameFromTarget(targetReplaced);
 
 		PythonModule::krait.setGlobalRequest("request", request);
@@ -281,7 +1380,21 @@ void Server::serveRequest(int clientSocket, Request& request) {
 
 	resp.setConnClose(!keepAlive);
 
-	respondWithObjectRef(clientSocket, resp);
+	try {
+		respondWithObjectRef(clientSocket, resp);
+		checkStreamedPage();
+	}
+	catch (networkError&) {
+		streamedPage = b::none;
+		throw;
+	}
+	catch (rootException& ex) {
+		//A streamed page failed halfway; the headers are out, so all that's left is cutting the response short.
+		Loggers::logErr(formatString("Error rendering streamed page: %1%", ex.what()));
+		streamedPage = b::none;
+		keepAlive = false;
+		shutdown(clientSocket, SHUT_RDWR);
+	}
 }
 
 
@@ -323,6 +1436,22 @@ std::string replaceParams(std::string target, std::map<std::string, std::string>
 }
 
 
+//The tag the client has, without its quotes.
+static std::string getIfNoneMatchTag(Request& request) {
+	std::string etag;
+	if (request.headerExists("if-none-match")) {
+		etag = request.getHeader("if-none-match").get();
+		//Compressed responses carry the weak form of the page's tag.
+		if (ba::starts_with(etag, "W/")) {
+			etag = etag.substr(2);
+		}
+		if (etag.length() >= 2) {
+			etag = etag.substr(1, etag.length() - 2);
+		}
+	}
+	return etag;
+}
+
 Response Server::getResponseFromSource(std::string filename, Request& request) {
 	filename = expandFilename(filename);
 
@@ -330,22 +1459,30 @@ Response Server::getResponseFromSource(std::string filename, Request& request) {
 		BOOST_THROW_EXCEPTION(notFoundError() << stringInfoFromFormat("Error: File not found: %1%", filename));
 	}
 
+	//Only requests getStaticTarget() turned down get here (e.g. a POST); they don't go through the cache.
+	if (isStaticFile(filename)) {
+		return getStaticResponse(std::make_shared<const OpenFile>(filename, true), request);
+	}
+
 	Response result(500, "", true);
 
 	bool isDynamic = getPymlIsDynamic(filename);
 	CacheController::CachePragma cachePragma = cacheController.getCacheControl(
 		relative(filename, serverRoot).string(), !isDynamic);
 
-	std::string etag;
-	if (request.headerExists("if-none-match")) {
-		etag = request.getHeader("if-none-match").get();
-		etag = etag.substr(1, etag.length() - 2);
-	}
+	std::string etag = getIfNoneMatchTag(request);
 	if (cachePragma.isStore && serverCache.checkCacheTag(filename, etag)) {
 		result = Response(304, "", false);
 	}
 	else {
-		IteratorResult pymlResult = getPymlResultRequestCache(filename);
+		//Only HTTP/1.1 has chunked responses; websockets pages are never sent at all.
+		bool canStream = (request.getHttpMajor() > 1 || (request.getHttpMajor() == 1 && request.getHttpMinor() >= 1)) &&
+			!request.isUpgrade("websocket");
+		IteratorResult pymlResult = getPymlResultRequestCache(filename, canStream ? config.getStreamBufferSize() : 0);
+		if (!pymlResult.isComplete() && !PythonModule::krait.checkIsNone("response")) {
+			//The page replaced its output; it still runs to the end, as it would without streaming.
+			pymlResult.finish();
+		}
 
 		std::multimap<std::string, std::string> headersMap = PythonModule::krait.getGlobalTupleList("extra_headers");
 		std::unordered_multimap<std::string, std::string> headers(headersMap.begin(), headersMap.end());
@@ -358,6 +1495,9 @@ Response Server::getResponseFromSource(std::string filename, Request& request) {
 			}
 		}
 		else {
+			if (!pymlResult.isComplete()) {
+				streamedPage = StreamedPage{filename, headersMap, getContentType(filename)};
+			}
 			result = Response(1, 1, 200, headers, pymlResult, false);
 		}
 	}
@@ -366,10 +1506,216 @@ Response Server::getResponseFromSource(std::string filename, Request& request) {
 
 
 	addDefaultHeaders(result, filename, request);
+	compressResponse(result, request);
+
+	return result;
+}
+
+
+void Server::respondWithStaticFile(int clientSocket, Request& request, std::shared_ptr<const OpenFile> file,
+                                   bool keepConnection) {
+	Response response = getStaticResponse(file, request);
+	if (request.getVerb() == HttpVerb::HEAD) {
+		response.setBody(std::string(), false);
+	}
+	response.setConnClose(!keepConnection);
+	respondWithObjectRef(clientSocket, response);
+}
+
+//Files without Python in them are sent straight from disk; they don't go through the cache.
+Response Server::getStaticResponse(std::shared_ptr<const OpenFile> file, Request& request) {
+	const std::string& filename = file->getPath();
+	//Lexically, without the filesystem calls relative() makes.
+	CacheController::CachePragma cachePragma = cacheController.getCacheControl(
+		bf::path(filename).lexically_relative(serverRoot).string(), true);
+
+	//A precompressed variant is a representation of its own, with its own ETag and ranges.
+	std::string contentEncoding;
+	std::shared_ptr<const OpenFile> sentFile = chooseFileVariant(file, request, &contentEncoding);
+
+	std::string contentType = getContentTypeByExtension(bf::path(filename).extension().string());
+
+	Response result(500, "", true);
+	if (cachePragma.isStore && getIfNoneMatchTag(request) == sentFile->getTag()) {
+		result = Response(304, "", false);
+	}
+	else {
+		result = Response(200, "", false);
+		result.setBodyFile(sentFile, 0, sentFile->getSize());
+		setRangeBody(result, sentFile, contentType, request);
+	}
+
+	result.setHeader("cache-control", cacheController.getValueFromPragma(cachePragma));
+	if (cachePragma.isStore) {
+		result.addHeader("etag", "\"" + sentFile->getTag() + "\"");
+	}
+	if (!contentEncoding.empty()) {
+		result.setHeader("content-encoding", contentEncoding);
+	}
+	if (file->hasVariants()) {
+		result.setHeader("vary", "Accept-Encoding");
+	}
+	result.setHeader("accept-ranges", "bytes");
+	result.setHeader("last-modified", unixTimeToString(sentFile->getModifiedTime()));
+
+	//Not addDefaultHeaders(); static files are also served from threads that can't use Python.
+	if (!result.headerExists("content-type")) {
+		result.setHeader("content-type", contentType);
+	}
+	std::time_t timeVal = std::time(NULL);
+	if (timeVal != -1) {
+		result.setHeader("date", unixTimeToString(timeVal));
+	}
 
 	return result;
 }
 
+//Picks the precompressed variant the client likes best (Brotli on ties); the file itself if it takes neither.
+std::shared_ptr<const OpenFile> Server::chooseFileVariant(std::shared_ptr<const OpenFile> file, Request& request,
+                                                          std::string* contentEncoding) {
+	b::optional<std::string> acceptEncoding = request.getHeader("accept-encoding");
+	if (!acceptEncoding || !file->hasVariants()) {
+		return file;
+	}
+
+	float brotliQuality = file->getBrotliVariant() ? getEncodingQuality(*acceptEncoding, "br") : 0;
+	float gzipQuality = file->getGzipVariant() ? getEncodingQuality(*acceptEncoding, "gzip") : 0;
+	if (brotliQuality > 0 && brotliQuality >= gzipQuality) {
+		*contentEncoding = "br";
+		return file->getBrotliVariant();
+	}
+	if (gzipQuality > 0) {
+		*contentEncoding = "gzip";
+		return file->getGzipVariant();
+	}
+	return file;
+}
+
+
+//Dynamic responses are compressed as they are sent; static files have precompressed variants instead.
+void Server::compressResponse(Response& response, Request& request) {
+	int statusCode = response.getStatusCode();
+	if (config.getCompressLevel() < 0 || (statusCode != 200 && statusCode != 304) ||
+		response.headerExists("content-encoding")) {
+		return;
+	}
+	b::optional<std::string> contentType = response.getHeader("content-type");
+	if (!contentType || !isCompressibleType(*contentType)) {
+		return;
+	}
+
+	//A 304 has no body to measure; the tag the client revalidates says whether its copy was compressed.
+	if (statusCode == 304) {
+		response.addHeader("Vary", "Accept-Encoding");
+		b::optional<std::string> clientTag = request.getHeader("if-none-match");
+		b::optional<std::string> etag = response.getHeader("etag");
+		if (clientTag && ba::starts_with(*clientTag, "W/") && etag && !ba::starts_with(*etag, "W/")) {
+			response.setHeader("etag", "W/" + *etag);
+		}
+		return;
+	}
+	//Streamed pages are long enough by definition.
+	if (!response.isBodyChunked() && response.getBodyLength() < config.getCompressMinSize()) {
+		return;
+	}
+
+	response.addHeader("Vary", "Accept-Encoding");
+	b::optional<std::string> acceptEncoding = request.getHeader("accept-encoding");
+	if (!acceptEncoding) {
+		return;
+	}
+
+	std::shared_ptr<ICompressionStream> compressor;
+	std::string encoding;
+	float gzipQuality = getEncodingQuality(*acceptEncoding, "gzip");
+#ifdef KRAIT_HAVE_BROTLI
+	float brotliQuality = getEncodingQuality(*acceptEncoding, "br");
+	if (brotliQuality > 0 && brotliQuality >= gzipQuality) {
+		compressor = std::make_shared<BrotliStream>(config.getCompressLevel());
+		encoding = "br";
+	}
+#endif
+	if (!compressor && gzipQuality > 0) {
+		compressor = std::make_shared<GzipStream>(config.getCompressLevel());
+		encoding = "gzip";
+	}
+	if (!compressor) {
+		return;
+	}
+
+	//The compressed bytes differ from the page's, so only a weak tag still describes them.
+	b::optional<std::string> etag = response.getHeader("etag");
+	if (etag && !ba::starts_with(*etag, "W/")) {
+		response.setHeader("etag", "W/" + *etag);
+	}
+	response.setBodyEncoding(compressor, encoding);
+}
+
+
+//Narrows a whole-file response to the ranges the client asked for (Range), if the file is still the one
+//the client has the rest of (If-Range).
+void Server::setRangeBody(Response& response, std::shared_ptr<const OpenFile> file, const std::string& contentType,
+                          Request& request) {
+	//Asking for more parts than this isn't worth serving; the whole file is cheaper.
+	const size_t maxRanges = 16;
+
+	b::optional<std::string> rangeHeader = request.getHeader("range");
+	if (!rangeHeader || (request.getVerb() != HttpVerb::GET && request.getVerb() != HttpVerb::HEAD)) {
+		return;
+	}
+
+	b::optional<std::string> ifRange = request.getHeader("if-range");
+	if (ifRange) {
+		//An ETag (strong comparison only), or the exact Last-Modified date.
+		bool isCurrent = ba::starts_with(*ifRange, "\"") ?
+			*ifRange == "\"" + file->getTag() + "\"" :
+			*ifRange == unixTimeToString(file->getModifiedTime());
+		if (!isCurrent) {
+			return;
+		}
+	}
+
+	unsigned long long size = (unsigned long long)file->getSize();
+	std::vector<ByteRange> ranges;
+	if (!parseByteRanges(*rangeHeader, size, ranges)) {
+		return;
+	}
+
+	if (ranges.empty()) {
+		response = Response(416, "", false);
+		response.setHeader("content-range", formatString("bytes */%1%", size));
+		return;
+	}
+
+	unsigned long long totalLength = 0;
+	for (const ByteRange& range : ranges) {
+		totalLength += range.length;
+	}
+	if (ranges.size() > maxRanges || totalLength > size) {
+		return;
+	}
+
+	response.setStatusCode(206);
+	if (ranges.size() == 1) {
+		const ByteRange& range = ranges[0];
+		response.setHeader("content-range",
+			formatString("bytes %1%-%2%/%3%", range.offset, range.offset + range.length - 1, size));
+		response.setBodyFile(file, (off_t)range.offset, (size_t)range.length);
+		return;
+	}
+
+	static thread_local std::mt19937_64 boundaryRandom{std::random_device()()};
+	std::string boundary = formatString("krait-%1$016x", boundaryRandom());
+	std::vector<FilePart> parts;
+	for (const ByteRange& range : ranges) {
+		std::string prefix = formatString("\r\n--%1%\r\nContent-Type: %2%\r\nContent-Range: bytes %3%-%4%/%5%\r\n\r\n",
+			boundary, contentType, range.offset, range.offset + range.length - 1, size);
+		parts.push_back(FilePart{prefix, (off_t)range.offset, (size_t)range.length});
+	}
+	response.setBodyFileParts(file, std::move(parts), formatString("\r\n--%1%--\r\n", boundary));
+	response.setHeader("content-type", "multipart/byteranges; boundary=" + boundary);
+}
+
 
 void Server::startWebsocketsServer(int clientSocket, Request& request) {
 	Response resp(500, "", true);
@@ -378,9 +1724,10 @@ void Server::startWebsocketsServer(int clientSocket, Request& request) {
 		request.setRouteVerb(RouteVerb::WEBSOCKET);
 
 		std::map<std::string, std::string> params;
-		const Route& route = Route::getRouteMatch(config.getRoutes(), request.getRouteVerb(), request.getUrl(), params);
+		std::string url = request.getUrl().to_string();
+		const Route& route = Route::getRouteMatch(config.getRoutes(), request.getRouteVerb(), url, params);
 
-		std::string targetReplaced = replaceParams(route.getTarget(request.getUrl()), params);
+		std::string targetReplaced = replaceParams(route.getTarget(url), params);
 		std::string sourceFile = getFilenameFromTarget(targetReplaced);
 
 		PythonModule::krait.setGlobalRequest("request", request);
@@ -410,6 +1757,10 @@ void Server::startWebsocketsServer(int clientSocket, Request& request) {
 }
 
 
+bool Server::isStaticFile(std::string filename) {
+	return !canContainPython(filename) && !ba::ends_with(filename, ".py");
+}
+
 bool Server::canContainPython(std::string filename) {
 	return ba::ends_with(filename, ".html") || ba::ends_with(filename, ".htm") || ba::ends_with(filename, ".pyml");
 }
@@ -457,11 +1808,28 @@ std::string Server::expandFilename(std::string filename) {
 }
 
 
-IteratorResult Server::getPymlResultRequestCache(std::string filename) {
+//A streamed page's headers are sent once the first chunk is rendered. Anything the page sets after that
+//can't be sent anymore; say so instead of dropping it silently.
+void Server::checkStreamedPage() {
+	if (!streamedPage) {
+		return;
+	}
+	StreamedPage page = *streamedPage;
+	streamedPage = b::none;
+
+	if (!PythonModule::krait.checkIsNone("response") ||
+		PythonModule::krait.getGlobalTupleList("extra_headers") != page.headers ||
+		getContentType(page.filename) != page.contentType) {
+		Loggers::logErr(formatString("Page %1% changed its headers, cookies or krait.response after it started streaming "
+			"(stream_buffer_size); the changes were not sent.", page.filename));
+	}
+}
+
+IteratorResult Server::getPymlResultRequestCache(std::string filename, size_t streamBufferSize) {
 	//DBG("Reading pyml cache");
 	interpretCacheRequest = true;
 	const IPymlFile* pymlFile = serverCache.get(filename);
-	return IteratorResult(PymlIterator(pymlFile->getRootItem()));
+	return IteratorResult(PymlIterator(pymlFile->getRootItem()), streamBufferSize);
 }
 
 bool Server::getPymlIsDynamic(std::string filename) {
@@ -556,6 +1924,10 @@ std::string Server::getContentType(std::string filename) {
 
 	//DBG_FMT("Extension: %1%", extension);
 
+	return getContentTypeByExtension(extension);
+}
+
+std::string Server::getContentTypeByExtension(std::string extension) {
 	auto it = contentTypeByExtension.find(extension);
 	if (it == contentTypeByExtension.end()) {
 		return "application/octet-stream";
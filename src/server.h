@@ -1,16 +1,60 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <deque>
+#include <ctime>
 #include <boost/filesystem/path.hpp>
 #include "except.h"
 #include "network.h"
 #include "response.h"
 #include "pymlFile.h"
 #include "stringPiper.h"
+#include "fdPiper.h"
 #include "pymlCache.h"
+#include "openFileCache.h"
 #include "cacheController.h"
 #include "config.h"
+#include "eventLoop.h"
+#include "scoreboard.h"
+
+
+struct ServerOptions
+{
+	int workers;
+	bool noRequestFork;
+	bool reusePort;
+	std::vector<int> cpuAffinity;
+	int acceptBatch;
+	int keepAliveParkMs;
+	int minWorkers;
+	int maxWorkers;
+	int maxWorkerRequests;
+	int maxWorkerAgeSec;
+	long maxWorkerRssKb;
+	int maxPending;
+	int queueDelayTargetMs;
+	int staticThreads;
+	std::vector<std::string> commandLine;
+};
+
+
+struct PendingClient
+{
+	int socket;
+	long long admittedMs;
+};
+
+//What a page had set when its headers went out, before it finished rendering.
+struct StreamedPage
+{
+	std::string filename;
+	std::multimap<std::string, std::string> headers;
+	std::string contentType;
+};
 
 
 class Server
@@ -18,11 +62,26 @@ class Server
 	static Server* instance;
 
 	boost::filesystem::path serverRoot;
+	int serverPort;
 	int serverSocket;
 
+	ServerOptions options;
+	std::vector<int> workerPids;
+	int staticPid;
+	Scoreboard scoreboard;
+	//One slot: busy is the pool threads serving a client, clientsTaken the clients they took.
+	Scoreboard staticScoreboard;
+	int targetWorkers;
+	int scaleUpTicks;
+	int scaleDownTicks;
+	std::time_t workerStartTime;
+	int workerRequestsServed;
+	bool workerRecycling;
+
 	const int maxKeepAliveSec = 60;
 	int keepAliveTimeoutSec;
 	bool keepAlive;
+	boost::optional<StreamedPage> streamedPage;
 
 	Config config;
 	CacheController cacheController;
@@ -31,47 +90,131 @@ class Server
 	int socketToClose;
 	bool stdinDisconnected;
 
+	EventLoop eventLoop;
+	int childSignalFd;
+
+	FdPiper idleClientPipe;
+	FdPiper clientDispatchPipe;
+	FdPiper staticDispatchPipe;
+	FdPiper staticHandbackPipe;
+	std::unordered_map<int, std::time_t> idleClients;
+	std::unordered_map<int, std::time_t> lingeringClients;
+	std::deque<PendingClient> dispatchBacklog;
+	int clientsInFlight;
+	//With no workers, the process serving each connection; other children (helpers, the logger) aren't clients.
+	std::unordered_set<int> connectionPids;
+	int staticClientsInFlight;
+	std::string overloadResponse;
+	bool overloaded;
+	long long delayIntervalStart;
+	std::time_t lastTick;
+
 	StringPiper cacheRequestPipe;
 	bool interpretCacheRequest;
 	PymlCache serverCache;
+	OpenFileCache openFileCache;
+	std::vector<OpenFileCache> staticFileCaches;
 
 	bool shutdownRequested;
+	bool reloadRequested;
+	int previousGenerationPid;
 
-	void tryAcceptConnection();
+	void acceptConnections();
+	void dispatchClient(int clientSocket);
 	void tryCheckStdinClosed() const;
-
-	void serveClientStart(int clientSocket);
+	void onChildSignal();
+	void initChildProcess();
+
+	void maintainWorkers();
+	void adjustWorkerCount();
+	bool spawnWorker(int slot);
+	void checkOpenFileLimit();
+	void runWorker(int slot);
+	void setWorkerAffinity(int slot);
+	bool workerRecycleDue();
+	int getWorkerClient(int slot, int timeoutMs);
+	bool masterAccepts() const;
+
+	void maintainStaticProcess();
+	void runStaticProcess();
+	void serveStaticClient(int clientSocket, long long admittedMs, size_t threadIdx);
+	void handBackStaticClient(int clientSocket, long long admittedMs);
+	std::shared_ptr<const OpenFile> getStaticTarget(Request& request, OpenFileCache& fileCache);
+	boost::optional<std::string> getStaticRouteTarget(Request& request);
+	bool isStaticRequest(int clientSocket);
+	int countStaticClients();
+	bool staticPoolHasRoom();
+	void receiveStaticHandbacks();
+
+	void admitClient(int clientSocket);
+	bool checkOverloaded(long long nowMs);
+	int countPendingClients();
+	void renderOverloadResponse();
+
+	bool parkIdleClient(int clientSocket);
+	void receiveIdleClients();
+	void watchIdleClient(int clientSocket, std::time_t expiry);
+	void onIdleClientEvent(int clientSocket);
+	void dispatchReadyClient(int clientSocket, long long admittedMs);
+	void dispatchDynamicClient(int clientSocket, long long admittedMs);
+	void flushDispatchBacklog();
+	void expireClients(std::unordered_map<int, std::time_t>& clients, std::time_t now);
+	void lingerClient(int clientSocket);
+	void onLingeringClientEvent(int clientSocket);
+	void onTick();
+
+	void serveClient(int clientSocket);
+	int checkRequestHead(const Request& head, unsigned long long bodyLength);
+	void serveRequestForked(int clientSocket, Request& request);
+	void serveRequestInProcess(int clientSocket, Request& request);
 	void serveRequest(int clientSocket, Request& request);
 	void addDefaultHeaders(Response& response, std::string filename, Request& request);
 	Response getResponseFromSource(std::string filename, Request& request);
+	Response getStaticResponse(std::shared_ptr<const OpenFile> file, Request& request);
+	void respondWithStaticFile(int clientSocket, Request& request, std::shared_ptr<const OpenFile> file, bool keepConnection);
+	std::shared_ptr<const OpenFile> chooseFileVariant(std::shared_ptr<const OpenFile> file, Request& request,
+	                                                  std::string* contentEncoding);
+	void setRangeBody(Response& response, std::shared_ptr<const OpenFile> file, const std::string& contentType,
+	                  Request& request);
+	void compressResponse(Response& response, Request& request);
 
 	std::string getFilenameFromTarget(std::string target);
 	std::string expandFilename(std::string filename);
 	static bool pathBlocked(std::string filename);
 
 	std::string getContentType(std::string filename);
+	std::string getContentTypeByExtension(std::string extension);
 	void loadContentTypeList();
 
 	void addStandardCacheHeaders(Response& response, std::string filename, CacheController::CachePragma pragma);
 
 	bool canContainPython(std::string filename);
+	bool isStaticFile(std::string filename);
 	void startWebsocketsServer(int clientSocket, Request& request);
 
 	PymlFile* constructPymlFromFilename(std::string filename, boost::object_pool<PymlFile>& pool, char* tagDest);
 	void onServerCacheMiss(std::string filename);
 
 	bool getPymlIsDynamic(std::string filename);
-	IteratorResult getPymlResultRequestCache(std::string filename);
+	IteratorResult getPymlResultRequestCache(std::string filename, size_t streamBufferSize);
+	void checkStreamedPage();
 
 	void updateParentCaches();
 
+	bool getInheritedServerSocket();
+	void startNextGeneration();
+	void warmUpCache();
+	void startPrecompression();
+	void precompressStaticFiles();
+
 public:
-	Server(std::string serverRoot, int port);
+	Server(std::string serverRoot, int port, ServerOptions options);
 	~Server();
 
 	void runServer();
 
 	void requestShutdown();
+	void requestReload();
 	void cleanup();
 
 	static Server* getInstance() {
@@ -74,6 +74,13 @@ void StopSignalHandler::handler(int signal, siginfo_t* info, void* ucontext) {
 	exit(0);
 }
 
+void ReloadSignalHandler::handler(int signal, siginfo_t* info, void* ucontext) {
+	//Only the master acts on this; it isn't passed on to the children.
+	if (Server::getInstance() != nullptr) {
+		Server::getInstance()->requestReload();
+	}
+}
+
 void KillSignalHandler::handler(int signal, siginfo_t* info, void* ucontext) {
 	Loggers::logInfo(formatString("Force stop requested for process %1%", getpid()));
 
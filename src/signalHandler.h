@@ -55,6 +55,16 @@ public:
 	void handler(int signal, siginfo_t* info, void* ucontext) override;
 };
 
+class ReloadSignalHandler : public SignalHandler
+{
+public:
+	ReloadSignalHandler()
+		: SignalHandler(std::vector<int>{SIGHUP}) {
+	}
+
+	void handler(int signal, siginfo_t* info, void* ucontext) override;
+};
+
 class KillSignalHandler : public SignalHandler
 {
 public:
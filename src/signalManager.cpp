@@ -1,6 +1,9 @@
 ﻿#include "except.h"
 #include "signalManager.h"
 #include <sys/wait.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include <errno.h>
 
 #include "dbg.h"
 
@@ -69,12 +72,60 @@ void SignalManager::removePid(int pid) {
 	}
 }
 
+bool SignalManager::hasPid(int pid) {
+	for (const auto childPid : childPids) {
+		if (childPid == pid) {
+			return true;
+		}
+	}
+	return false;
+}
+
 void SignalManager::signalChildren(int signal) {
 	for (const auto pid : childPids) {
 		kill(pid, signal);
 	}
 }
 
+static sigset_t getChildSignalMask() {
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	return mask;
+}
+
+//Blocks SIGCHLD and returns a signalfd that becomes readable when a child stops.
+int SignalManager::createChildSignalFd() {
+	sigset_t mask = getChildSignalMask();
+	if (sigprocmask(SIG_BLOCK, &mask, NULL) != 0) {
+		BOOST_THROW_EXCEPTION(syscallError() << stringInfo("sigprocmask(): blocking SIGCHLD") << errcodeInfoDef());
+	}
+
+	int signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (signalFd == -1) {
+		BOOST_THROW_EXCEPTION(syscallError() << stringInfo("signalfd(): creating SIGCHLD fd") << errcodeInfoDef());
+	}
+	return signalFd;
+}
+
+void SignalManager::drainSignalFd(int signalFd) {
+	signalfd_siginfo info;
+	while (read(signalFd, &info, sizeof(info)) == sizeof(info)) {
+	}
+}
+
+//Undoes createChildSignalFd() in a forked child.
+void SignalManager::restoreChildSignal(int signalFd) {
+	if (signalFd != -1) {
+		close(signalFd);
+	}
+
+	sigset_t mask = getChildSignalMask();
+	if (sigprocmask(SIG_UNBLOCK, &mask, NULL) != 0) {
+		BOOST_THROW_EXCEPTION(syscallError() << stringInfo("sigprocmask(): unblocking SIGCHLD") << errcodeInfoDef());
+	}
+}
+
 int SignalManager::waitStoppedChildren() {
 	if (childPids.size() == 0) {
 		return 0;
@@ -29,13 +29,22 @@ public:
 	}
 
 	static void removePid(int pid);
+	static bool hasPid(int pid);
 
 	static void clearPids() {
 		childPids.clear();
 	}
 
+	static size_t getPidCount() {
+		return childPids.size();
+	}
+
 	static void signalChildren(int signal);
 
+	static int createChildSignalFd();
+	static void drainSignalFd(int signalFd);
+	static void restoreChildSignal(int signalFd);
+
 	static int waitStoppedChildren();
 	static void waitChildrenBlocking();
 	static void waitChild(int pid);
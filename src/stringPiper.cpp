@@ -1,6 +1,7 @@
 #include<unistd.h>
 #include<stdio.h>
 #include<poll.h>
+#include<errno.h>
 #include"stringPiper.h"
 #include"except.h"
 #include"limits.h"
@@ -80,14 +81,17 @@ std::string StringPiper::pipeRead() {
 }
 
 
-bool StringPiper::pipeAvailable() {
+bool StringPiper::pipeAvailable(int timeoutMs) {
 	pollfd pfd;
 	pfd.fd = readHead;
 	pfd.events = POLLIN;
 	pfd.revents = 0;
 
-	int pollResult = poll(&pfd, 1, 0);
+	int pollResult = poll(&pfd, 1, timeoutMs);
 	if (pollResult == -1) {
+		if (errno == EINTR) {
+			return false;
+		}
 		BOOST_THROW_EXCEPTION(syscallError() << stringInfo("poll(): getting StringPiper::pipeAvailable") << errcodeInfoDef());
 	}
 	if (pollResult == 0) {
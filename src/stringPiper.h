@@ -10,11 +10,15 @@ public:
 	StringPiper();
 	~StringPiper();
 
+	int getReadHead() const {
+		return readHead;
+	}
+
 	void closeRead();
 	void closeWrite();
 	void closePipes();
 
 	void pipeWrite(std::string data);
-	bool pipeAvailable();
+	bool pipeAvailable(int timeoutMs = 0);
 	std::string pipeRead();
 };
@@ -52,6 +52,24 @@ errcodeInfo errcodeInfoDef() {
 	return errcodeInfo(errno);
 }
 
+//Reads the resident set size from /proc/self/statm; returns -1 if it can't be read.
+long getResidentMemoryKb() {
+	std::ifstream statm("/proc/self/statm");
+	long sizePages;
+	long residentPages;
+	if (!(statm >> sizePages >> residentPages)) {
+		return -1;
+	}
+	return residentPages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+//Milliseconds on a clock shared by all processes, unaffected by changes to the system time.
+long long getMonotonicMs() {
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
 std::string readFromFile(std::string filename) {
 	std::ifstream fileIn(filename, std::ios::in | std::ios::binary);
 
@@ -140,6 +158,10 @@ void generateTagFromStat(std::string filename, char* dest) {
 		BOOST_THROW_EXCEPTION(syscallError() << stringInfoFromFormat("stat(): generating ETag") << errcodeInfoDef());
 	}
 
+	generateTagFromStat(statResult, dest);
+}
+
+void generateTagFromStat(const struct stat& statResult, char* dest) {
 	std::string result = formatString("%x%x%x", (int)statResult.st_ino, (int)statResult.st_size, (int)statResult.st_mtime);
 	strcpy(dest, result.c_str());
 }
@@ -12,7 +12,10 @@ struct PipePair
 };
 
 bool fdClosed(int fd);
+long getResidentMemoryKb();
+long long getMonotonicMs();
 std::string readFromFile(std::string filename);
 std::string unixTimeToString(std::time_t timeVal);
 std::time_t stringToUnixTime(std::string str);
 void generateTagFromStat(std::string filename, char* dest);
+void generateTagFromStat(const struct stat& statResult, char* dest);
@@ -0,0 +1,104 @@
+#include <signal.h>
+#include <pthread.h>
+#include "workStealingPool.h"
+#include "logger.h"
+#include "formatHelper.h"
+
+#define DBG_DISABLE
+#include "dbg.h"
+
+
+WorkStealingPool::WorkStealingPool(size_t threadCount)
+	: nextQueue(0), pendingTasks(0), stopping(false) {
+	for (size_t i = 0; i < threadCount; i++) {
+		queues.emplace_back(new TaskQueue());
+	}
+	for (size_t i = 0; i < threadCount; i++) {
+		threads.emplace_back(&WorkStealingPool::runThread, this, i);
+	}
+}
+
+WorkStealingPool::~WorkStealingPool() {
+	stop();
+}
+
+
+void WorkStealingPool::submit(Task task) {
+	TaskQueue& queue = *queues[nextQueue++ % queues.size()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+	{
+		std::lock_guard<std::mutex> lock(idleMutex);
+		pendingTasks++;
+	}
+	idleCondition.notify_one();
+}
+
+void WorkStealingPool::stop() {
+	{
+		std::lock_guard<std::mutex> lock(idleMutex);
+		stopping = true;
+	}
+	idleCondition.notify_all();
+
+	for (std::thread& thread : threads) {
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+}
+
+
+bool WorkStealingPool::takeTask(size_t threadIdx, Task& task) {
+	for (size_t i = 0; i < queues.size(); i++) {
+		TaskQueue& queue = *queues[(threadIdx + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty()) {
+			continue;
+		}
+		//Our own queue in order; the newest of someone else's, which its thread would get to last.
+		if (i == 0) {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+		}
+		else {
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+		}
+		return true;
+	}
+	return false;
+}
+
+void WorkStealingPool::runThread(size_t threadIdx) {
+	//Signals are left to the thread that owns the pool.
+	sigset_t signals;
+	sigfillset(&signals);
+	pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(idleMutex);
+			idleCondition.wait(lock, [this]() { return pendingTasks != 0 || stopping; });
+			if (pendingTasks == 0) {
+				return;
+			}
+			pendingTasks--;
+		}
+
+		//A task is queued for every one counted, but another thread may be taking the one we saw.
+		Task task;
+		while (!takeTask(threadIdx, task)) {
+			std::this_thread::yield();
+		}
+
+		try {
+			task(threadIdx);
+		}
+		catch (std::exception& ex) {
+			Loggers::logErr(formatString("Error in pool thread %1%: %2%", threadIdx, ex.what()));
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+
+/*
+	A fixed set of threads, each with a queue of its own. Tasks are spread over the queues in turn;
+	a thread runs its own tasks oldest first and, when it has none, steals the newest task of another thread.
+	Tasks get the index of the thread running them, for state kept per thread.
+*/
+class WorkStealingPool
+{
+public:
+	typedef std::function<void(size_t threadIdx)> Task;
+
+private:
+	struct TaskQueue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<TaskQueue>> queues;
+	std::vector<std::thread> threads;
+	std::atomic<size_t> nextQueue;
+
+	//Counts the tasks not yet taken by a thread; idle threads sleep on it.
+	std::mutex idleMutex;
+	std::condition_variable idleCondition;
+	size_t pendingTasks;
+	bool stopping;
+
+	bool takeTask(size_t threadIdx, Task& task);
+	void runThread(size_t threadIdx);
+
+public:
+	explicit WorkStealingPool(size_t threadCount);
+	~WorkStealingPool();
+
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	size_t getThreadCount() const {
+		return queues.size();
+	}
+
+	void submit(Task task);
+
+	//Runs the tasks already submitted, then joins the threads.
+	void stop();
+};